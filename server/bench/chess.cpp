@@ -0,0 +1,316 @@
+#include "chess.hpp"
+#include "game.hpp"
+#include "position.hpp"
+#include "sliders.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+// Middlegames from common openings and endgames of the kinds the server
+// adjudicates, each with either side to move.
+static const char* const corpus_fens[] = {
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R2QKB1R w KQ - 0 8",
+    "r2q1rk1/1b2bppp/p1n1pn2/1pp5/3P4/2PBPN2/PP1N1PPP/R2Q1RK1 w - - 0 11",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R b KQkq - 0 5",
+    "2rq1rk1/pp1bppbp/3p1np1/4n3/3NP3/1BN1BP2/PPPQ2PP/2KR3R b - - 0 12",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/5pk1/6p1/8/3R4/6P1/5PK1/8 b - - 0 1",
+    "8/8/4k3/8/2K5/3Q4/8/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/8/1p6/p1p2k2/P1P5/1P3K2/8/8 b - - 0 1",
+    "4k3/8/8/3BN3/8/8/8/4K3 w - - 0 1",
+};
+
+struct Position
+{
+    Board board;
+    Color turn;
+    // every (piece, square) of the side to move
+    std::vector<std::pair<ColoredPiece, Square>> pieces;
+    // every move possible_moves offers those pieces, legal or not
+    std::vector<SimpleMove> requests;
+    // the legal ones
+    std::vector<SimpleMove> legal;
+};
+
+static const std::vector<Position>& corpus()
+{
+    static const std::vector<Position> positions = []() {
+        std::vector<Position> positions;
+        for (const char* fen : corpus_fens) {
+            auto b = from_fen(fen);
+            if (!b) {
+                std::cerr << "Error: bad corpus position " << fen << std::endl;
+                std::exit(1);
+            }
+            Position p{*b, b->side_to_move(), {}, {}, {}};
+            for (int i = 0; i < 64; ++i) {
+                Square from = index_square(i);
+                auto cp = p.board.piece_at(from);
+                if (!cp || cp->color != p.turn) {
+                    continue;
+                }
+                p.pieces.push_back({*cp, from});
+                for (Bitboard bb = possible_moves(*cp, from); bb;
+                     bb &= bb - 1) {
+                    Square to = index_square(__builtin_ctzll(bb));
+                    p.requests.push_back({from, to});
+                    if (move(p.board, p.turn, from, to)) {
+                        p.legal.push_back({from, to});
+                    }
+                }
+            }
+            positions.push_back(p);
+        }
+        return positions;
+    }();
+    return positions;
+}
+
+static void BM_PieceAt(benchmark::State& state)
+{
+    const auto& positions = corpus();
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (const Position& p : positions) {
+            for (int i = 0; i < 64; ++i) {
+                benchmark::DoNotOptimize(p.board.piece_at(index_square(i)));
+            }
+            items += 64;
+        }
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_PieceAt);
+
+static void BM_BoardCopy(benchmark::State& state)
+{
+    const auto& positions = corpus();
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (const Position& p : positions) {
+            Board copy = p.board;
+            benchmark::DoNotOptimize(copy);
+            benchmark::ClobberMemory();
+        }
+        items += positions.size();
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_BoardCopy);
+
+// Legal and illegal requests alike, as they arrive from clients.
+static void BM_Move(benchmark::State& state)
+{
+    std::vector<Position> positions = corpus();
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (Position& p : positions) {
+            for (const SimpleMove& m : p.requests) {
+                benchmark::DoNotOptimize(move(p.board, p.turn, m.from, m.to));
+            }
+            items += p.requests.size();
+        }
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_Move);
+
+static void BM_InCheck(benchmark::State& state)
+{
+    const auto& positions = corpus();
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (const Position& p : positions) {
+            benchmark::DoNotOptimize(in_check(p.board, WHITE));
+            benchmark::DoNotOptimize(in_check(p.board, BLACK));
+        }
+        items += 2 * positions.size();
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_InCheck);
+
+static void BM_CanMove(benchmark::State& state)
+{
+    std::vector<Position> positions = corpus();
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (Position& p : positions) {
+            benchmark::DoNotOptimize(can_move(p.board, p.turn));
+        }
+        items += positions.size();
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_CanMove);
+
+static void BM_PossibleMoves(benchmark::State& state)
+{
+    const auto& positions = corpus();
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (const Position& p : positions) {
+            for (const auto& piece : p.pieces) {
+                benchmark::DoNotOptimize(
+                    possible_moves(piece.first, piece.second));
+            }
+            items += p.pieces.size();
+        }
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_PossibleMoves);
+
+// Every legal move of each position, each on a fresh copy of the board.
+static void BM_TryMove(benchmark::State& state)
+{
+    const auto& positions = corpus();
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (const Position& p : positions) {
+            for (const SimpleMove& m : p.legal) {
+                Board b = p.board;
+                benchmark::DoNotOptimize(try_move(b, p.turn, m.from, m.to));
+            }
+            items += p.legal.size();
+        }
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_TryMove);
+
+static void BM_ShowMoveResult(benchmark::State& state)
+{
+    std::vector<MoveResult> results;
+    for (const Position& p : corpus()) {
+        for (const SimpleMove& m : p.legal) {
+            Board b = p.board;
+            results.push_back(*try_move(b, p.turn, m.from, m.to));
+        }
+    }
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (const MoveResult& r : results) {
+            benchmark::DoNotOptimize(show(r));
+        }
+        items += results.size();
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_ShowMoveResult);
+
+static void BM_ReadSquare(benchmark::State& state)
+{
+    std::vector<std::string> words;
+    for (int i = 0; i < 64; ++i) {
+        words.push_back(show(index_square(i)));
+    }
+    // what a client may send instead
+    for (const char* word : {"", "e", "i1", "a9", "e22", "E4"}) {
+        words.push_back(word);
+    }
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (const std::string& word : words) {
+            benchmark::DoNotOptimize(read_square(word));
+        }
+        items += words.size();
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_ReadSquare);
+
+// Every rook and bishop square of every corpus position.
+static void BM_SlidingAttacks(benchmark::State& state)
+{
+    std::vector<Bitboard> boards;
+    for (const Position& p : corpus()) {
+        boards.push_back(p.board.occupied());
+    }
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (Bitboard occupied : boards) {
+            for (int i = 0; i < 64; ++i) {
+                benchmark::DoNotOptimize(rook_attacks(i, occupied));
+                benchmark::DoNotOptimize(bishop_attacks(i, occupied));
+            }
+        }
+        items += 128 * boards.size();
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_SlidingAttacks);
+
+// The same by walking every ray to the first piece, as the rules did
+// before the lookups, for comparison.
+static void BM_SlidingWalk(benchmark::State& state)
+{
+    static const Square dirs[8] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1},
+                                   {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+    std::vector<Bitboard> boards;
+    for (const Position& p : corpus()) {
+        boards.push_back(p.board.occupied());
+    }
+    int64_t items = 0;
+    for (auto _ : state) {
+        for (Bitboard occupied : boards) {
+            for (int i = 0; i < 64; ++i) {
+                Square s = index_square(i);
+                for (int piece = 0; piece < 8; piece += 4) {
+                    Bitboard attacks = 0;
+                    for (int d = piece; d < piece + 4; ++d) {
+                        Square to = {s.row + dirs[d].row, s.col + dirs[d].col};
+                        for (; on_board(to); to.row += dirs[d].row,
+                                             to.col += dirs[d].col) {
+                            attacks |= square_bit(to);
+                            if (occupied & square_bit(to)) {
+                                break;
+                            }
+                        }
+                    }
+                    benchmark::DoNotOptimize(attacks);
+                }
+            }
+        }
+        items += 128 * boards.size();
+    }
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_SlidingWalk);
+
+// bin/bench_chess [--lookup=magic|pext] [benchmark flags]
+//
+// Everything runs with the sliding attack lookup given, or the one picked
+// for this CPU, which is recorded in the results as "lookup".
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    for (int i = 1; i < argc; ++i) {
+        const char* lookup = std::strncmp(argv[i], "--lookup=", 9) == 0 ?
+                             argv[i] + 9 : nullptr;
+        if (lookup && std::strcmp(lookup, "magic") == 0) {
+            use_sliding_lookup(MAGIC_LOOKUP);
+        } else if (lookup && std::strcmp(lookup, "pext") == 0) {
+            if (!use_sliding_lookup(PEXT_LOOKUP)) {
+                std::cerr << "Error: this CPU has no PEXT" << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "usage: bench_chess [--lookup=magic|pext] "
+                         "[benchmark flags]" << std::endl;
+            return 2;
+        }
+    }
+    benchmark::AddCustomContext(
+        "lookup", sliding_lookup() == PEXT_LOOKUP ? "pext" : "magic");
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
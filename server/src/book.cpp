@@ -0,0 +1,84 @@
+#include "book.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+uint16_t book_move(SimpleMove m)
+{
+    return uint16_t(square_index(m.from) << 6 | square_index(m.to));
+}
+
+SimpleMove book_move_squares(uint16_t move)
+{
+    return SimpleMove{index_square(move >> 6 & 63), index_square(move & 63)};
+}
+
+static bool key_less(const BookEntry& a, const BookEntry& b)
+{
+    return a.key < b.key;
+}
+
+void write_book(std::ostream& out, std::vector<BookEntry> entries)
+{
+    std::sort(entries.begin(), entries.end(),
+              [](const BookEntry& a, const BookEntry& b) {
+                  return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+              });
+    BookHeader header;
+    std::memcpy(header.magic, book_magic, sizeof(header.magic));
+    header.count = entries.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+              entries.size() * sizeof(BookEntry));
+}
+
+// lookups jump around the file, read-ahead would only waste cache
+OpeningBook::OpeningBook(const std::string& path) :
+    file(path, MappedFile::RANDOM),
+    entries(nullptr),
+    count(0)
+{
+    const BookHeader* header =
+        reinterpret_cast<const BookHeader*>(file.data());
+    if (file.size() < sizeof(BookHeader) ||
+        std::memcmp(header->magic, book_magic, sizeof(book_magic)) != 0 ||
+        header->count != (file.size() - sizeof(BookHeader)) /
+                         sizeof(BookEntry)) {
+        throw std::runtime_error("not a book: " + path);
+    }
+    entries = reinterpret_cast<const BookEntry*>(header + 1);
+    count = header->count;
+}
+
+size_t OpeningBook::size() const
+{
+    return count;
+}
+
+OpeningBook::Range OpeningBook::lookup(uint64_t key) const
+{
+    BookEntry probe = BookEntry();
+    probe.key = key;
+    return std::equal_range(entries, entries + count, probe, key_less);
+}
+
+boost::optional<SimpleMove> OpeningBook::pick(uint64_t key,
+                                              uint32_t random) const
+{
+    Range moves = lookup(key);
+    uint64_t total = 0;
+    for (const BookEntry* e = moves.first; e != moves.second; ++e) {
+        total += e->weight;
+    }
+    if (!total) {
+        return boost::none;
+    }
+    uint64_t choice = random % total;
+    for (const BookEntry* e = moves.first; ; ++e) {
+        if (choice < e->weight) {
+            return book_move_squares(e->move);
+        }
+        choice -= e->weight;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef BOOK_HPP
+#define BOOK_HPP
+
+#include "chess.hpp"
+#include "mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/optional.hpp>
+
+// Opening book file: a header and then entries sorted by key, the moves of
+// a position by falling weight. Keys are Board::hash() values, so a book
+// only fits the Zobrist keys it was built with. Written in host byte order.
+struct BookEntry
+{
+    uint64_t key;
+    // from and to as square indexes, from << 6 | to
+    uint16_t move;
+    uint16_t weight;
+    uint32_t reserved;
+};
+
+struct BookHeader
+{
+    char magic[8];
+    uint64_t count;
+};
+
+const char book_magic[8] = {'P', 'S', 'Z', 'B', 'O', 'O', 'K', '1'};
+
+uint16_t book_move(SimpleMove);
+SimpleMove book_move_squares(uint16_t);
+
+// Sorts the entries and writes a book.
+void write_book(std::ostream&, std::vector<BookEntry>);
+
+// A book mapped read-only. Opening it only maps the file, whatever its
+// size, and lookups point into the mapping; processes opening the same
+// file share its pages.
+class OpeningBook
+{
+public:
+    typedef std::pair<const BookEntry*, const BookEntry*> Range;
+
+    // Throws std::runtime_error if the file is missing or malformed.
+    explicit OpeningBook(const std::string& path);
+
+    size_t size() const;
+    Range lookup(uint64_t key) const;
+    // Picks a move with probability proportional to its weight, given a
+    // uniformly random number.
+    boost::optional<SimpleMove> pick(uint64_t key, uint32_t random) const;
+private:
+    MappedFile file;
+    const BookEntry* entries;
+    size_t count;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "chess.hpp"
 
+#include "sliders.hpp"
+#include <cassert>
 #include <utility>
 
 struct ApplyMoveVisitor : public boost::static_visitor<>
@@ -34,6 +36,331 @@ struct ApplyMoveVisitor : public boost::static_visitor<>
     }
 };
 
+struct UndoMoveVisitor : public boost::static_visitor<>
+{
+    Board* board;
+
+    UndoMoveVisitor(Board& b) : board(&b) {}
+
+    void operator()(SimpleMove& m) const
+    {
+        board->move(m.to, m.from);
+    }
+
+    void operator()(Castle& m) const
+    {
+        switch (m.dir) {
+        case KINGSIDE:
+            board->move({m.king.row, 6}, m.king);
+            board->move({m.king.row, 5}, {m.king.row, 7});
+            break;
+        case QUEENSIDE:
+            board->move({m.king.row, 2}, m.king);
+            board->move({m.king.row, 3}, {m.king.row, 0});
+            break;
+        }
+    }
+
+    void operator()(Promotion& m) const
+    {
+        board->remove(m.to);
+        board->put({m.color, PAWN}, m.from);
+    }
+};
+
+struct EndpointsVisitor : public boost::static_visitor<SimpleMove>
+{
+    SimpleMove operator()(const SimpleMove& m) const
+    {
+        return m;
+    }
+
+    SimpleMove operator()(const Castle& m) const
+    {
+        int col = m.dir == KINGSIDE ? 6 : 2;
+        return SimpleMove{m.king, {m.king.row, col}};
+    }
+
+    SimpleMove operator()(const Promotion& m) const
+    {
+        return SimpleMove{m.from, m.to};
+    }
+};
+
+static constexpr Square knight_diffs[8] =
+    {{2, 1}, {-2, 1}, {2, -1}, {-2, -1}, {1, 2}, {-1, 2}, {1, -2}, {-1, -2}};
+static constexpr Square king_diffs[8] =
+    {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+// the rook's four, then the bishop's four
+static constexpr Square directions[8] =
+    {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+// What every piece can reach from every square of an empty board, built at
+// compile time so that move generation and validation are lookups.
+struct AttackTables
+{
+    Bitboard knight[64];
+    Bitboard king[64];
+    // the squares two columns away a king castles to
+    Bitboard castle[64];
+    // the squares a pawn of each color captures on, and pushes to
+    Bitboard pawn[2][64];
+    Bitboard pawn_push[2][64];
+    // the rows and columns through the square, and the diagonals
+    Bitboard orthogonal[64];
+    Bitboard diagonal[64];
+    // the squares strictly between two squares on a line, else none
+    Bitboard between[64][64];
+
+    constexpr AttackTables() :
+        knight(), king(), castle(), pawn(), pawn_push(), orthogonal(),
+        diagonal(), between()
+    {
+        for (int i = 0; i < 64; ++i) {
+            Square s = index_square(i);
+            for (int k = 0; k < 8; ++k) {
+                knight[i] |= bit({s.row + knight_diffs[k].row,
+                                  s.col + knight_diffs[k].col});
+                king[i] |= bit({s.row + king_diffs[k].row,
+                                s.col + king_diffs[k].col});
+            }
+            castle[i] = bit({s.row, s.col - 2}) | bit({s.row, s.col + 2});
+            for (int c = -1; c <= 1; c += 2) {
+                pawn[WHITE][i] |= bit({s.row - 1, s.col + c});
+                pawn[BLACK][i] |= bit({s.row + 1, s.col + c});
+            }
+            pawn_push[WHITE][i] = bit({s.row - 1, s.col}) |
+                                  bit({s.row - 2, s.col});
+            pawn_push[BLACK][i] = bit({s.row + 1, s.col}) |
+                                  bit({s.row + 2, s.col});
+
+            for (int d = 0; d < 8; ++d) {
+                Bitboard passed = 0;
+                Square to = {s.row + directions[d].row,
+                             s.col + directions[d].col};
+                for (; on_board(to); to.row += directions[d].row,
+                                     to.col += directions[d].col) {
+                    between[i][square_index(to)] = passed;
+                    passed |= square_bit(to);
+                }
+                (d < 4 ? orthogonal : diagonal)[i] |= passed;
+            }
+        }
+    }
+
+    static constexpr Bitboard bit(Square s)
+    {
+        return on_board(s) ? square_bit(s) : 0;
+    }
+};
+
+static constexpr AttackTables attacks;
+
+// What differs between the sides, for the rules templated on one of them.
+// Rows count from black's back rank, so white moves toward row 0.
+template <Color C>
+struct Side
+{
+    static constexpr Color opponent = C == WHITE ? BLACK : WHITE;
+    static constexpr int forward = C == WHITE ? -1 : 1;
+    static constexpr int promotion_row = C == WHITE ? 0 : 7;
+};
+
+template <Color By>
+static bool attacked(const Board& b, int i)
+{
+    Bitboard occupied = b.occupied();
+    Bitboard queens = b.pieces(By, QUEEN);
+    // a pawn attacks the square from where a pawn of the other color on
+    // the square would
+    return (attacks.pawn[Side<By>::opponent][i] & b.pieces(By, PAWN)) ||
+           (attacks.knight[i] & b.pieces(By, KNIGHT)) ||
+           (attacks.king[i] & b.pieces(By, KING)) ||
+           (rook_attacks(i, occupied) & (b.pieces(By, ROOK) | queens)) ||
+           (bishop_attacks(i, occupied) & (b.pieces(By, BISHOP) | queens));
+}
+
+template <Color C>
+static bool king_attacked(const Board& b)
+{
+    Bitboard king = b.pieces(C, KING);
+    return king && attacked<Side<C>::opponent>(b, __builtin_ctzll(king));
+}
+
+template <Color C>
+static boost::optional<Move> validate(const Board&, Square from, Square to);
+
+// Pseudo-legal move generation for generate_legal_moves: every move that
+// move_maybe_to_check would accept, without asking it square by square.
+template <Color C>
+class MoveGenerator
+{
+public:
+    MoveGenerator(Board& b, MoveList& out) :
+        board(b), moves(out)
+    {}
+
+    void piece(Piece p, Square from)
+    {
+        int i = square_index(from);
+        switch (p) {
+        case PAWN:
+            pawn(from);
+            break;
+        case KNIGHT:
+            targets(from, attacks.knight[i]);
+            break;
+        case BISHOP:
+            targets(from, bishop_attacks(i, board.occupied()));
+            break;
+        case ROOK:
+            targets(from, rook_attacks(i, board.occupied()));
+            break;
+        case QUEEN:
+            targets(from, bishop_attacks(i, board.occupied()) |
+                          rook_attacks(i, board.occupied()));
+            break;
+        case KING:
+            targets(from, attacks.king[i]);
+            castle(from);
+            break;
+        }
+    }
+private:
+    Board& board;
+    MoveList& moves;
+
+    void add(Square from, Square to, bool hit)
+    {
+        Move m{SimpleMove{from, to}, boost::none};
+        if (hit) {
+            m.hit = to;
+        }
+        push_legal(m);
+    }
+
+    void push_legal(const Move& m)
+    {
+        Undo u = apply(board, m);
+        bool legal = !king_attacked<C>(board);
+        undo(board, m, u);
+        if (legal) {
+            moves.push_back(m);
+        }
+    }
+
+    // Every square of the set that is not the mover's own.
+    void targets(Square from, Bitboard squares)
+    {
+        Bitboard occupied = board.occupied();
+        for (Bitboard bb = squares & ~board.pieces(C); bb; bb &= bb - 1) {
+            int to = __builtin_ctzll(bb);
+            add(from, index_square(to), occupied >> to & 1);
+        }
+    }
+
+    void pawn(Square from)
+    {
+        Square one = {from.row + Side<C>::forward, from.col};
+        if (!on_board(one)) {
+            return;
+        }
+        bool promotes = one.row == Side<C>::promotion_row;
+
+        if (!(board.occupied() & square_bit(one))) {
+            pawn_move(from, one, false, promotes);
+            Square two = {from.row + 2 * Side<C>::forward, from.col};
+            if (on_board(two) && !board.has_moved(from) &&
+                !(board.occupied() & square_bit(two))) {
+                pawn_move(from, two, false,
+                          two.row == Side<C>::promotion_row);
+            }
+        }
+        Bitboard captures = attacks.pawn[C][square_index(from)] &
+                            board.pieces(Side<C>::opponent);
+        for (; captures; captures &= captures - 1) {
+            Square to = index_square(__builtin_ctzll(captures));
+            pawn_move(from, to, true, promotes);
+        }
+    }
+
+    void pawn_move(Square from, Square to, bool hit, bool promotes)
+    {
+        if (!promotes) {
+            add(from, to, hit);
+            return;
+        }
+        Move m{Promotion{from, to, C}, boost::none};
+        if (hit) {
+            m.hit = to;
+        }
+        push_legal(m);
+    }
+
+    void castle(Square from)
+    {
+        if (board.has_moved(from)) {
+            return;
+        }
+        for (int dc = -2; dc <= 2; dc += 4) {
+            auto m = validate<C>(board, from, {from.row, from.col + dc});
+            if (m) {
+                push_legal(*m);
+            }
+        }
+    }
+};
+
+// Random keys from a fixed splitmix64 stream, so hashes are stable across
+// runs and can be stored.
+struct ZobristKeys
+{
+    uint64_t pieces[2][6][64];
+    uint64_t castling[16];
+    uint64_t side;
+
+    constexpr ZobristKeys() : pieces(), castling(), side()
+    {
+        uint64_t state = 0x2545f4914f6cdd1dULL;
+        for (auto& color : pieces) {
+            for (auto& piece : color) {
+                for (uint64_t& k : piece) {
+                    k = next(state);
+                }
+            }
+        }
+        for (uint64_t& k : castling) {
+            k = next(state);
+        }
+        side = next(state);
+    }
+
+    static constexpr uint64_t next(uint64_t& state)
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+static constexpr ZobristKeys zobrist;
+
+// Castling rights as a 4-bit index: a king and rook that both have not
+// moved since they were put on their home squares.
+static int castling_rights(Bitboard unmoved)
+{
+    static const Bitboard e1 = Bitboard(1) << 60, e8 = Bitboard(1) << 4;
+    int rights = 0;
+    if (unmoved & e1) {
+        rights |= (unmoved >> 63 & 1) | (unmoved >> 56 & 1) << 1;
+    }
+    if (unmoved & e8) {
+        rights |= (unmoved >> 7 & 1) << 2 | (unmoved & 1) << 3;
+    }
+    return rights;
+}
+
 bool operator <(Square s1, Square s2)
 {
     return s1.row == s2.row ? s1.col < s2.col : s1.row < s2.row;
@@ -44,84 +371,136 @@ bool operator ==(Square s1, Square s2)
     return s1.row == s2.row && s1.col == s2.col;
 }
 
+Board::Board() :
+    by_color(), by_piece(), unmoved(0), key(zobrist.castling[0]), side(WHITE)
+{}
+
 bool Board::has_moved(Square s) const
 {
-    return initial_squares.find(s) == initial_squares.end();
+    return !on_board(s) || !(unmoved & square_bit(s));
 }
 
 boost::optional<ColoredPiece> Board::piece_at(Square square) const
 {
-    auto it = white_pieces.find(square);
-    if (it != white_pieces.end()){
-        return ColoredPiece{WHITE, it->second};
+    Bitboard bit = square_bit(square);
+    if (!(occupied() & bit)) {
+        return boost::none;
     }
-    it = black_pieces.find(square);
-    if (it != black_pieces.end()) {
-        return ColoredPiece{BLACK, it->second};
+    Color c = by_color[BLACK] & bit ? BLACK : WHITE;
+    int p = KING;
+    while (!(by_piece[p] & bit)) {
+        ++p;
     }
-    return boost::none_t();
+    return ColoredPiece{c, Piece(p)};
 }
 
 Square Board::king_pos(Color c) const
 {
-    auto& player_pieces = c == WHITE ? white_pieces : black_pieces;
-    return std::find_if(
-            player_pieces.begin(),
-            player_pieces.end(),
-            [](std::pair<Square, Piece> p) {return p.second == KING;})
-        ->first;
+    return index_square(__builtin_ctzll(pieces(c, KING)));
 }
 
 bool Board::any_piece(Color c, std::function<bool(Square, Piece)> f) const
 {
-    auto& pcs = c == WHITE ? white_pieces : black_pieces;
-    return std::any_of(
-            pcs.begin(),
-            pcs.end(),
-            [f](std::pair<Square, Piece> p) {return f(p.first, p.second);});
+    for (int p = KING; p <= PAWN; ++p) {
+        for (Bitboard bb = pieces(c, Piece(p)); bb; bb &= bb - 1) {
+            if (f(index_square(__builtin_ctzll(bb)), Piece(p))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+Bitboard Board::occupied() const
+{
+    return by_color[WHITE] | by_color[BLACK];
+}
+
+Bitboard Board::pieces(Color c) const
+{
+    return by_color[c];
+}
+
+Bitboard Board::pieces(Color c, Piece p) const
+{
+    return by_color[c] & by_piece[p];
+}
+
+Bitboard Board::unmoved_pieces() const
+{
+    return unmoved;
+}
+
+uint64_t Board::hash() const
+{
+    return key;
+}
+
+uint64_t Board::compute_hash() const
+{
+    uint64_t h = zobrist.castling[castling_rights(unmoved)];
+    for (int c = WHITE; c <= BLACK; ++c) {
+        for (int p = KING; p <= PAWN; ++p) {
+            for (Bitboard bb = pieces(Color(c), Piece(p)); bb; bb &= bb - 1) {
+                h ^= zobrist.pieces[c][p][__builtin_ctzll(bb)];
+            }
+        }
+    }
+    return side == BLACK ? h ^ zobrist.side : h;
 }
 
 void Board::move(Square from, Square to)
 {
     ColoredPiece cp = *piece_at(from);
-    switch (cp.color) {
-    case WHITE:
-        white_pieces.erase(from);
-        white_pieces[to] = cp.piece;
-        break;
-    case BLACK:
-        black_pieces.erase(from);
-        black_pieces[to] = cp.piece;
-        break;
+    auto captured = piece_at(to);
+    if (captured) {
+        toggle(*captured, to);
     }
-    initial_squares.erase(from);
+    toggle(cp, from);
+    toggle(cp, to);
+    set_unmoved(unmoved & ~square_bit(from));
 }
 
 void Board::put(ColoredPiece cp, Square s)
 {
-    switch (cp.color) {
-    case WHITE:
-        white_pieces[s] = cp.piece;
-        break;
-    case BLACK:
-        black_pieces[s] = cp.piece;
-        break;
+    auto old = piece_at(s);
+    if (old) {
+        toggle(*old, s);
     }
-    initial_squares.insert(s);
+    toggle(cp, s);
+    set_unmoved(unmoved | square_bit(s));
 }
 
 void Board::remove(Square from)
 {
-    ColoredPiece cp = *piece_at(from);
-    switch (cp.color) {
-    case WHITE:
-        white_pieces.erase(from);
-        break;
-    case BLACK:
-        black_pieces.erase(from);
-        break;
-    }
-    initial_squares.erase(from);
+    toggle(*piece_at(from), from);
+    set_unmoved(unmoved & ~square_bit(from));
+}
+
+void Board::set_unmoved(Bitboard mask)
+{
+    key ^= zobrist.castling[castling_rights(unmoved)] ^
+           zobrist.castling[castling_rights(mask)];
+    unmoved = mask;
+}
+
+Color Board::side_to_move() const
+{
+    return side;
+}
+
+void Board::flip_side()
+{
+    side = side == WHITE ? BLACK : WHITE;
+    key ^= zobrist.side;
+}
+
+void Board::toggle(ColoredPiece cp, Square s)
+{
+    Bitboard bit = square_bit(s);
+    by_color[cp.color] ^= bit;
+    by_piece[cp.piece] ^= bit;
+    key ^= zobrist.pieces[cp.color][cp.piece][square_index(s)];
 }
 
 Board initial_position()
@@ -143,7 +522,7 @@ boost::optional<MoveResult> try_move(Board& b, Color as, Square from, Square to)
 {
     auto maybe_move = move(b, as, from, to);
     if (!maybe_move) {
-        return boost::none_t();
+        return boost::none;
     }
 
     apply(b, *maybe_move);
@@ -156,309 +535,198 @@ boost::optional<MoveResult> try_move(Board& b, Color as, Square from, Square to)
     return mr;
 }
 
-void apply(Board& board, Move move)
+Undo apply(Board& board, Move move)
 {
+    Undo u;
+    u.unmoved = board.unmoved_pieces();
     if (move.hit) {
+        u.captured = board.piece_at(*move.hit)->piece;
         board.remove(*move.hit);
     }
     boost::apply_visitor(ApplyMoveVisitor(board), move.movement);
+    board.flip_side();
+    assert(board.hash() == board.compute_hash());
+    return u;
 }
 
-boost::optional<Move> move(const Board& b, Color as, Square from, Square to)
+void undo(Board& board, Move move, const Undo& u)
+{
+    boost::apply_visitor(UndoMoveVisitor(board), move.movement);
+    if (u.captured) {
+        Color mover = board.piece_at(endpoints(move).from)->color;
+        Color opp = mover == WHITE ? BLACK : WHITE;
+        board.put({opp, *u.captured}, *move.hit);
+    }
+    board.set_unmoved(u.unmoved);
+    board.flip_side();
+    assert(board.hash() == board.compute_hash());
+}
+
+boost::optional<Move> move(Board& b, Color as, Square from, Square to)
 {
     auto maybe_move = move_maybe_to_check(b, as, from, to);
     if (!maybe_move) {
         return maybe_move;
     }
 
-    Move move = *maybe_move;
-    Board next_board = b;
-    apply(next_board, move);
-    if (in_check(next_board, as)) {
-        return boost::none_t();
+    Undo u = apply(b, *maybe_move);
+    bool leaves_check = in_check(b, as);
+    undo(b, *maybe_move, u);
+    if (leaves_check) {
+        return boost::none;
     }
 
     return maybe_move;
 }
 
+SimpleMove endpoints(const Move& m)
+{
+    return boost::apply_visitor(EndpointsVisitor(), m.movement);
+}
+
 bool in_check(const Board& b, Color c)
 {
-    Square player_king = b.king_pos(c);
-    Color opp = c == WHITE ? BLACK : WHITE;
-    return b.any_piece(
-            opp,
-            [&](Square s, Piece p) {
-                return move_maybe_to_check(b, opp, s, player_king);
-            });
-}
-
-bool can_move(const Board& b, Color c)
-{
-    return b.any_piece(
-            c,
-            [&](Square s, Piece p) {
-                auto moves = possible_moves({c, p}, s);
-                for (Square to : moves) {
-                    auto m = move(b, c, s, to);
-                    if (m) {
-                        return true;
-                    }
-                }
-                return false;
-            });
+    return c == WHITE ? king_attacked<WHITE>(b) : king_attacked<BLACK>(b);
 }
 
-std::vector<Square> possible_moves(ColoredPiece cp, Square pos)
+bool square_attacked(const Board& b, Square s, Color by)
 {
-    std::vector<Square> diffs;
+    int i = square_index(s);
+    return by == WHITE ? attacked<WHITE>(b, i) : attacked<BLACK>(b, i);
+}
+
+bool can_move(Board& b, Color c)
+{
+    MoveList moves;
+    generate_legal_moves(b, c, moves);
+    return !moves.empty();
+}
+
+template <Color C>
+static void generate(Board& b, MoveList& moves)
+{
+    MoveGenerator<C> gen(b, moves);
+    for (int p = KING; p <= PAWN; ++p) {
+        for (Bitboard bb = b.pieces(C, Piece(p)); bb; bb &= bb - 1) {
+            gen.piece(Piece(p), index_square(__builtin_ctzll(bb)));
+        }
+    }
+}
+
+void generate_legal_moves(Board& b, Color c, MoveList& moves)
+{
+    moves.clear();
+    if (c == WHITE) {
+        generate<WHITE>(b, moves);
+    } else {
+        generate<BLACK>(b, moves);
+    }
+}
+
+Bitboard possible_moves(ColoredPiece cp, Square pos)
+{
+    int i = square_index(pos);
     switch (cp.piece) {
     case PAWN:
-        if (cp.color == WHITE) {
-            diffs = {{-1, 0}, {-2, 0}, {-1, -1}, {-1, 1}};
-        } else {
-            diffs = {{1, 0}, {2, 0}, {1, -1}, {1, 1}};
-        }
-        break;
+        return attacks.pawn[cp.color][i] | attacks.pawn_push[cp.color][i];
     case ROOK:
-        for (int i = -7; i <= 7; ++i) {
-            diffs.push_back({i, 0});
-            diffs.push_back({0, i});
-        }
-        break;
+        return attacks.orthogonal[i];
     case KNIGHT:
-        diffs = {{2, 1}, {-2, 1}, {2, -1}, {-2, -1},
-                 {1, 2}, {-1, 2}, {1, -2}, {-1, -2}};
-        break;
+        return attacks.knight[i];
     case BISHOP:
-        for (int i = -7; i <= 7; ++i) {
-            diffs.push_back({i, i});
-            diffs.push_back({i, -i});
-        }
-        break;
+        return attacks.diagonal[i];
     case QUEEN:
-        for (int i = -7; i <= 7; ++i) {
-            diffs.push_back({i, 0});
-            diffs.push_back({0, i});
-            diffs.push_back({i, i});
-            diffs.push_back({i, -i});
-        }
-        break;
+        return attacks.orthogonal[i] | attacks.diagonal[i];
     case KING:
-        diffs = {{-1, -1}, {-1, 0}, {-1, 1},
-                 {0, -1}, {0, 1},
-                 {1, -1}, {1, 0}, {1, 1},
-                 {0, -2}, {0, 2}};
-        break;
-    }
-    for (Square& s : diffs) {
-        s.row += pos.row;
-        s.col += pos.col;
+        return attacks.king[i] | attacks.castle[i];
     }
-    diffs.erase(
-        std::remove_if(
-            diffs.begin(),
-            diffs.end(),
-            [](Square s) {return s.row < 0 || s.col < 0 ||
-                                 s.row >= 8 || s.col >= 8;}),
-        diffs.end());
-    return diffs;
+    return 0;
 }
 
-// warning: long ugly monolithic function :(
-boost::optional<Move> move_maybe_to_check(const Board& b, Color as, Square from,
-                                          Square to)
+template <Color C>
+static boost::optional<Move> validate(const Board& b, Square from, Square to)
 {
+    if (!on_board(from) || !on_board(to)) {
+        return boost::none;
+    }
+
     auto maybe_piece = b.piece_at(from);
-    if (from == to || !maybe_piece || maybe_piece->color != as) {
-        return boost::none_t();
+    if (from == to || !maybe_piece || maybe_piece->color != C) {
+        return boost::none;
     }
 
-    Piece piece = maybe_piece->piece;
-    Square diff = {to.row - from.row, to.col - from.col};
-    boost::optional<Move> result;
-    bool l;
-    switch (piece) {
+    int f = square_index(from), t = square_index(to);
+    Bitboard target = square_bit(to);
+    Bitboard occupied = b.occupied();
+    if (b.pieces(C) & target) {
+        return boost::none;
+    }
+    Move simple{SimpleMove{from, to}, boost::none};
+    if (occupied & target) {
+        simple.hit = to;
+    }
+
+    switch (maybe_piece->piece) {
     case PAWN:
-        if (as == WHITE) {
-            boost::optional<Move> res;
-            if (diff == Square{-1, 0} && !b.piece_at(to)) {
-                res = Move{SimpleMove{from, to}, boost::none_t()};
-            } else if (diff == Square{-2, 0} && !b.piece_at(to) &&
-                       !b.piece_at(Square{from.row - 1, from.col}) &&
-                       !b.has_moved(from)) {
-                res = Move{SimpleMove{from, to}, boost::none_t()};
-            } else if ((diff == Square{-1, -1} || diff == Square{-1, 1}) &&
-                       b.piece_at(to) && b.piece_at(to)->color != as) {
-                res = Move{SimpleMove{from, to}, to};
-            }
-            if (res && to.row == 0) {
-                res->movement = Promotion{from, to, WHITE};
-            }
-            return res;
-        } else {
-            boost::optional<Move> res;
-            if (diff == Square{1, 0} && !b.piece_at(to)) {
-                res = Move{SimpleMove{from, to}, boost::none_t()};
-            } else if (diff == Square{2, 0} && !b.piece_at(to) &&
-                       !b.piece_at(Square{from.row + 1, from.col}) &&
-                       !b.has_moved(from)) {
-                res = Move{SimpleMove{from, to}, boost::none_t()};
-            } else if ((diff == Square{1, -1} || diff == Square{1, 1}) &&
-                       b.piece_at(to) && b.piece_at(to)->color != as) {
-                res = Move{SimpleMove{from, to}, to};
-            }
-            if (res && to.row == 7) {
-                res->movement = Promotion{from, to, BLACK};
+        if (attacks.pawn[C][f] & target) {
+            if (!simple.hit) {
+                return boost::none;
             }
-            return res;
+        } else if (!(attacks.pawn_push[C][f] & target) || simple.hit ||
+                   (attacks.between[f][t] & occupied) ||
+                   (to.row == from.row + 2 * Side<C>::forward &&
+                    b.has_moved(from))) {
+            return boost::none;
         }
-        break;
+        if (to.row == Side<C>::promotion_row) {
+            simple.movement = Promotion{from, to, C};
+        }
+        return simple;
     case ROOK:
-        if (diff.row == 0 || diff.col == 0) {
-            l = false;
-            if (diff.row == 0) {
-                for (int i = std::min(from.col, to.col) + 1;
-                     i <= std::max(from.col, to.col) - 1 && !l;
-                     ++i) {
-                    l = b.piece_at({from.row, i});
-                }
-            } else {
-                for (int i = std::min(from.row, to.row) + 1;
-                     i <= std::max(from.row, to.row) - 1 && !l;
-                     ++i) {
-                    l = b.piece_at({i, from.col});
-                }
-            }
-            if (!l) {
-                if (!b.piece_at(to)) {
-                    return Move{SimpleMove{from, to}, boost::none_t()};
-                } else if (b.piece_at(to)->color != as) {
-                    return Move{SimpleMove{from, to}, to};
-                }
-            }
+        if (rook_attacks(f, occupied) & target) {
+            return simple;
         }
         break;
     case KNIGHT:
-        if (diff == Square{1, 2} || diff == Square{2, 1} ||
-            diff == Square{-1, 2} || diff == Square{2, -1} ||
-            diff == Square{1, -2} || diff == Square{-2, 1} ||
-            diff == Square{-1, -2} || diff == Square{-2, -1}) {
-            if (!b.piece_at(to)) {
-                return Move{SimpleMove{from, to}, boost::none_t()};
-            } else if (b.piece_at(to)->color != as) {
-                return Move{SimpleMove{from, to}, to};
-            }
+        if (attacks.knight[f] & target) {
+            return simple;
         }
         break;
     case BISHOP:
-        if (diff.row == diff.col || diff.row == -diff.col) {
-            l = false;
-            if (diff.row == diff.col) {
-                for (int d = std::min(diff.row, 0) + 1;
-                     d <= std::max(0, diff.row) - 1 && !l;
-                     ++d) {
-                    l = b.piece_at({from.row + d, from.col + d});
-                }
-            } else {
-                for (int d = std::min(diff.row, 0) + 1;
-                     d <= std::max(0, diff.row) - 1 && !l;
-                     ++d) {
-                    l = b.piece_at({from.row + d, from.col - d});
-                }
-            }
-            if (!l) {
-                if (!b.piece_at(to)) {
-                    return Move{SimpleMove{from, to}, boost::none_t()};
-                } else if (b.piece_at(to)->color != as) {
-                    return Move{SimpleMove{from, to}, to};
-                }
-            }
+        if (bishop_attacks(f, occupied) & target) {
+            return simple;
         }
         break;
-    case QUEEN: // TODO factor out
-        if (diff.row == 0 || diff.col == 0) {
-            l = false;
-            if (diff.row == 0) {
-                for (int i = std::min(from.col, to.col) + 1;
-                     i <= std::max(from.col, to.col) - 1 && !l;
-                     ++i) {
-                    l = b.piece_at({from.row, i});
-                }
-            } else {
-                for (int i = std::min(from.row, to.row) + 1;
-                     i <= std::max(from.row, to.row) - 1 && !l;
-                     ++i) {
-                    l = b.piece_at({i, from.col});
-                }
-            }
-            if (!l) {
-                if (!b.piece_at(to)) {
-                    return Move{SimpleMove{from, to}, boost::none_t()};
-                } else if (b.piece_at(to)->color != as) {
-                    return Move{SimpleMove{from, to}, to};
-                }
-            }
-        } else if (diff.row == diff.col || diff.row == -diff.col) {
-            l = false;
-            if (diff.row == diff.col) {
-                for (int d = std::min(diff.row, 0) + 1;
-                     d <= std::max(0, diff.row) - 1 && !l;
-                     ++d) {
-                    l = b.piece_at({from.row + d, from.col + d});
-                }
-            } else {
-                for (int d = std::min(diff.row, 0) + 1;
-                     d <= std::max(0, diff.row) - 1 && !l;
-                     ++d) {
-                    l = b.piece_at({from.row + d, from.col - d});
-                }
-            }
-            if (!l) {
-                if (!b.piece_at(to)) {
-                    return Move{SimpleMove{from, to}, boost::none_t()};
-                } else if (b.piece_at(to)->color != as) {
-                    return Move{SimpleMove{from, to}, to};
-                }
-            }
+    case QUEEN:
+        if ((rook_attacks(f, occupied) | bishop_attacks(f, occupied)) &
+            target) {
+            return simple;
         }
         break;
     case KING:
-        if (diff == Square{-1, -1} || diff == Square{-1, 0} ||
-            diff == Square{-1, 1} || diff == Square{0, -1} ||
-            diff == Square{0, 1} || diff == Square{1, -1} ||
-            diff == Square{1, 0} || diff == Square{1, 1}) {
-            if (!b.piece_at(to)) {
-                return Move{SimpleMove{from, to}, boost::none_t()};
-            } else if (b.piece_at(to)->color != as) {
-                return Move{SimpleMove{from, to}, to};
+        if (attacks.king[f] & target) {
+            return simple;
+        } else if ((attacks.castle[f] & target) && !b.has_moved(from)) {
+            // the rook is three columns away on the king's side and four
+            // on the queen's
+            bool kingside = to.col > from.col;
+            Square rook = {from.row, kingside ? from.col + 3 : from.col - 4};
+            Square over = {from.row, kingside ? from.col + 1 : from.col - 1};
+            if (on_board(rook) && !b.has_moved(rook) &&
+                !(attacks.between[f][square_index(rook)] & occupied) &&
+                !attacked<Side<C>::opponent>(b, f) &&
+                !attacked<Side<C>::opponent>(b, square_index(over))) {
+                return Move{Castle{from, kingside ? KINGSIDE : QUEENSIDE}};
             }
-        } else if ((diff == Square{0, -2} || diff == Square{0, 2}) &&
-                    !b.has_moved(from)) {
-            if (diff.col == 2) {
-                if (!b.piece_at({from.row, from.col + 1}) &&
-                    !b.piece_at({from.row, from.col + 2}) &&
-                    !b.has_moved({from.row, from.col + 3})) {
-                    Board b1 = b;
-                    b1.move(from, {from.row, from.col + 1});
-                    if (!in_check(b1, as)) {
-                        return Move{Castle{from, KINGSIDE}};
-                    }
-                }
-            } else {
-                if (!b.piece_at({from.row, from.col - 1}) &&
-                    !b.piece_at({from.row, from.col - 2}) &&
-                    !b.piece_at({from.row, from.col - 3}) &&
-                    !b.has_moved({from.row, from.col - 4})) {
-                    Board b1 = b;
-                    b1.move(from, {from.row, from.col - 1});
-                    if (!in_check(b1, as)) {
-                        return Move{Castle{from, QUEENSIDE}};
-                    }
-                }
-            }
-
         }
         break;
     }
-    return boost::none_t();
+    return boost::none;
+}
+
+boost::optional<Move> move_maybe_to_check(const Board& b, Color as, Square from,
+                                          Square to)
+{
+    return as == WHITE ? validate<WHITE>(b, from, to) :
+                         validate<BLACK>(b, from, to);
 }
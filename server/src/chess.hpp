@@ -1,8 +1,8 @@
 #ifndef CHESS_HPP
 #define CHESS_HPP
 
-#include <map>
-#include <set>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <boost/optional.hpp>
 #include <boost/variant.hpp>
@@ -69,6 +69,23 @@ struct Move
     boost::optional<Square> hit;
 };
 
+// Fixed-capacity list filled by generate_legal_moves. No position has more
+// than 218 legal moves, so it never needs to grow.
+struct MoveList
+{
+    static const int capacity = 256;
+
+    Move moves[capacity];
+    int size = 0;
+
+    void push_back(const Move& m) { moves[size++] = m; }
+    void clear() { size = 0; }
+    bool empty() const { return size == 0; }
+
+    const Move* begin() const { return moves; }
+    const Move* end() const { return moves + size; }
+};
+
 struct MoveResult
 {
     Move move;
@@ -76,33 +93,95 @@ struct MoveResult
     bool opponent_cannot_move;
 };
 
+// One bit per square, bit index = row * 8 + col (a8 = 0, h1 = 63).
+typedef uint64_t Bitboard;
+
+constexpr bool on_board(Square s)
+{
+    return s.row >= 0 && s.row < 8 && s.col >= 0 && s.col < 8;
+}
+
+constexpr int square_index(Square s)
+{
+    return s.row * 8 + s.col;
+}
+
+constexpr Square index_square(int i)
+{
+    return Square{i >> 3, i & 7};
+}
+
+constexpr Bitboard square_bit(Square s)
+{
+    return Bitboard(1) << square_index(s);
+}
+
 class Board
 {
 public:
+    Board();
+
     bool has_moved(Square) const;
     boost::optional<ColoredPiece> piece_at(Square) const;
     Square king_pos(Color) const;
 
     bool any_piece(Color, std::function<bool(Square, Piece)>) const;
 
+    Bitboard occupied() const;
+    Bitboard pieces(Color) const;
+    Bitboard pieces(Color, Piece) const;
+    Bitboard unmoved_pieces() const;
+
+    // Zobrist key of the pieces, the castling rights implied by the unmoved
+    // kings and rooks, and the side to move (flipped by apply and undo).
+    uint64_t hash() const;
+    uint64_t compute_hash() const;
+
     void move(Square from, Square to);
     void put(ColoredPiece, Square s);
     void remove(Square from);
+    void set_unmoved(Bitboard);
+
+    Color side_to_move() const;
+    void flip_side();
 private:
-    std::map<Square, Piece> white_pieces, black_pieces;
-    std::set<Square> initial_squares;
+    Bitboard by_color[2];
+    Bitboard by_piece[6];
+    Bitboard unmoved;
+    uint64_t key;
+    Color side;
+
+    void toggle(ColoredPiece, Square);
+};
+
+// What apply() destroys and undo() needs back: the captured piece and the
+// moved flags of every square before the move.
+struct Undo
+{
+    boost::optional<Piece> captured;
+    Bitboard unmoved;
 };
 
 Board initial_position();
 
 boost::optional<MoveResult> try_move(Board&, Color as, Square from, Square to);
 
-void apply(Board&, Move);
-boost::optional<Move> move(const Board&, Color as, Square from, Square to);
+Undo apply(Board&, Move);
+void undo(Board&, Move, const Undo&);
+// Tests legality by applying and undoing on the given board, which is
+// unchanged when it returns.
+boost::optional<Move> move(Board&, Color as, Square from, Square to);
+
+// The squares a move is entered with: a castle goes from the king's square
+// two columns toward the rook.
+SimpleMove endpoints(const Move&);
 
 bool in_check(const Board&, Color);
-bool can_move(const Board&, Color);
-std::vector<Square> possible_moves(ColoredPiece, Square);
+bool square_attacked(const Board&, Square, Color by);
+bool can_move(Board&, Color);
+void generate_legal_moves(Board&, Color, MoveList&);
+// The squares the piece could move to from the square on an empty board.
+Bitboard possible_moves(ColoredPiece, Square);
 boost::optional<Move> move_maybe_to_check(const Board&, Color as, Square from,
                                           Square to);
 
@@ -0,0 +1,475 @@
+#include "engine.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace chrono = std::chrono;
+
+static const int infinity = 1000000;
+static const int max_ply = 64;
+
+// indexed by Piece: KING, QUEEN, ROOK, BISHOP, KNIGHT, PAWN
+static const int piece_value[6] = {0, 900, 500, 330, 320, 100};
+
+// Piece-square tables from white's point of view, row 0 being the eighth
+// rank; black pieces look them up mirrored.
+static const int square_value[6][8][8] = {
+    { // king, middlegame
+        {-30, -40, -40, -50, -50, -40, -40, -30},
+        {-30, -40, -40, -50, -50, -40, -40, -30},
+        {-30, -40, -40, -50, -50, -40, -40, -30},
+        {-30, -40, -40, -50, -50, -40, -40, -30},
+        {-20, -30, -30, -40, -40, -30, -30, -20},
+        {-10, -20, -20, -20, -20, -20, -20, -10},
+        { 20,  20,   0,   0,   0,   0,  20,  20},
+        { 20,  30,  10,   0,   0,  10,  30,  20}
+    },
+    { // queen
+        {-20, -10, -10,  -5,  -5, -10, -10, -20},
+        {-10,   0,   0,   0,   0,   0,   0, -10},
+        {-10,   0,   5,   5,   5,   5,   0, -10},
+        { -5,   0,   5,   5,   5,   5,   0,  -5},
+        {  0,   0,   5,   5,   5,   5,   0,  -5},
+        {-10,   5,   5,   5,   5,   5,   0, -10},
+        {-10,   0,   5,   0,   0,   0,   0, -10},
+        {-20, -10, -10,  -5,  -5, -10, -10, -20}
+    },
+    { // rook
+        {  0,   0,   0,   0,   0,   0,   0,   0},
+        {  5,  10,  10,  10,  10,  10,  10,   5},
+        { -5,   0,   0,   0,   0,   0,   0,  -5},
+        { -5,   0,   0,   0,   0,   0,   0,  -5},
+        { -5,   0,   0,   0,   0,   0,   0,  -5},
+        { -5,   0,   0,   0,   0,   0,   0,  -5},
+        { -5,   0,   0,   0,   0,   0,   0,  -5},
+        {  0,   0,   0,   5,   5,   0,   0,   0}
+    },
+    { // bishop
+        {-20, -10, -10, -10, -10, -10, -10, -20},
+        {-10,   0,   0,   0,   0,   0,   0, -10},
+        {-10,   0,   5,  10,  10,   5,   0, -10},
+        {-10,   5,   5,  10,  10,   5,   5, -10},
+        {-10,   0,  10,  10,  10,  10,   0, -10},
+        {-10,  10,  10,  10,  10,  10,  10, -10},
+        {-10,   5,   0,   0,   0,   0,   5, -10},
+        {-20, -10, -10, -10, -10, -10, -10, -20}
+    },
+    { // knight
+        {-50, -40, -30, -30, -30, -30, -40, -50},
+        {-40, -20,   0,   0,   0,   0, -20, -40},
+        {-30,   0,  10,  15,  15,  10,   0, -30},
+        {-30,   5,  15,  20,  20,  15,   5, -30},
+        {-30,   0,  15,  20,  20,  15,   0, -30},
+        {-30,   5,  10,  15,  15,  10,   5, -30},
+        {-40, -20,   0,   5,   5,   0, -20, -40},
+        {-50, -40, -30, -30, -30, -30, -40, -50}
+    },
+    { // pawn
+        {  0,   0,   0,   0,   0,   0,   0,   0},
+        { 50,  50,  50,  50,  50,  50,  50,  50},
+        { 10,  10,  20,  30,  30,  20,  10,  10},
+        {  5,   5,  10,  25,  25,  10,   5,   5},
+        {  0,   0,   0,  20,  20,   0,   0,   0},
+        {  5,  -5, -10,   0,   0, -10,  -5,   5},
+        {  5,  10,  10, -20, -20,  10,  10,   5},
+        {  0,   0,   0,   0,   0,   0,   0,   0}
+    }
+};
+
+static const int endgame_king_value[8][8] = {
+    {-50, -40, -30, -20, -20, -30, -40, -50},
+    {-30, -20, -10,   0,   0, -10, -20, -30},
+    {-30, -10,  20,  30,  30,  20, -10, -30},
+    {-30, -10,  30,  40,  40,  30, -10, -30},
+    {-30, -10,  30,  40,  40,  30, -10, -30},
+    {-30, -10,  20,  30,  30,  20, -10, -30},
+    {-30, -30,   0,   0,   0,   0, -30, -30},
+    {-50, -30, -30, -30, -30, -30, -30, -50}
+};
+
+// non-pawn material of both sides below which kings should centralize
+static const int endgame_material = 2 * (piece_value[ROOK] + piece_value[BISHOP]);
+
+int evaluate(const Board& b, Color c)
+{
+    int score[2] = {0, 0};
+    int material = 0;
+    for (int color = WHITE; color <= BLACK; ++color) {
+        for (int p = QUEEN; p <= KNIGHT; ++p) {
+            material += piece_value[p] *
+                        __builtin_popcountll(b.pieces(Color(color), Piece(p)));
+        }
+    }
+
+    for (int color = WHITE; color <= BLACK; ++color) {
+        for (int p = KING; p <= PAWN; ++p) {
+            for (Bitboard bb = b.pieces(Color(color), Piece(p)); bb;
+                 bb &= bb - 1) {
+                Square s = index_square(__builtin_ctzll(bb));
+                int row = color == WHITE ? s.row : 7 - s.row;
+                score[color] += piece_value[p];
+                if (p == KING && material <= endgame_material) {
+                    score[color] += endgame_king_value[row][s.col];
+                } else {
+                    score[color] += square_value[p][row][s.col];
+                }
+            }
+        }
+    }
+    return c == WHITE ? score[WHITE] - score[BLACK]
+                      : score[BLACK] - score[WHITE];
+}
+
+static bool is_promotion(const Move& m)
+{
+    return m.movement.which() == 2;
+}
+
+// Moves in the table: valid:1 | kind:3 | from:6 | to:6. The kind tells a
+// castle from a king step between the same squares.
+static uint16_t encode(const Move& m)
+{
+    SimpleMove e = endpoints(m);
+    return uint16_t(1 << 15 | m.movement.which() << 12 |
+                    square_index(e.from) << 6 | square_index(e.to));
+}
+
+// Mate scores are stored as distance from the node rather than the root, so
+// they stay right wherever the position is met again, and squeezed into
+// the table's 16 bits.
+static const int table_mate = 30000;
+
+static int16_t to_table(int score, int ply)
+{
+    if (score > mate_score - 2 * max_ply) {
+        return int16_t(table_mate - (mate_score - score - ply));
+    }
+    if (score < -mate_score + 2 * max_ply) {
+        return int16_t(-table_mate + (mate_score + score - ply));
+    }
+    return int16_t(score);
+}
+
+static int from_table(int score, int ply)
+{
+    if (score > table_mate - 2 * max_ply) {
+        return mate_score - (table_mate - score) - ply;
+    }
+    if (score < -table_mate + 2 * max_ply) {
+        return -mate_score + (table_mate + score) + ply;
+    }
+    return score;
+}
+
+class Searcher
+{
+public:
+    // Thread 0 keeps the clock and reports; helpers run until it stops
+    // them.
+    Searcher(Board& b, SearchLimits l, TranspositionTable& table,
+             std::atomic<bool>& stop, int thread) :
+        board(b),
+        limits(l),
+        deadline(chrono::steady_clock::now() + l.time),
+        tt(table),
+        stop(stop),
+        thread(thread),
+        nodes(0),
+        stopped(false),
+        killers()
+    {}
+
+    SearchResult run(Color c)
+    {
+        auto start = chrono::steady_clock::now();
+        SearchResult result = {boost::none, 0, 0, 0, 0};
+
+        MoveList moves;
+        generate_legal_moves(board, c, moves);
+        if (!moves.empty()) {
+            result.best = moves.moves[0];
+        }
+
+        // odd helpers start a ply deeper so the threads spread over two
+        // depths and fill the table for each other
+        int max_depth = thread ? max_ply - 1 : limits.max_depth;
+        for (int depth = 1 + thread % 2;
+             depth <= max_depth && moves.size > 1 && !stopped;
+             ++depth) {
+            boost::optional<Move> best;
+            int score = root(c, depth, moves, result.best, best);
+            // a first iteration cut short still beats the fallback, unless
+            // it ran out of time before finishing a single move
+            if (stopped && (depth > 1 || thread || !best)) {
+                break;
+            }
+            result.best = best;
+            result.score = score;
+            result.depth = depth;
+            if (score > mate_score - max_ply || score < -mate_score + max_ply) {
+                break;
+            }
+        }
+
+        result.nodes = nodes;
+        result.seconds = chrono::duration<double>(
+                chrono::steady_clock::now() - start).count();
+        return result;
+    }
+private:
+    Board& board;
+    SearchLimits limits;
+    chrono::steady_clock::time_point deadline;
+    TranspositionTable& tt;
+    std::atomic<bool>& stop;
+    int thread;
+    uint64_t nodes;
+    bool stopped;
+    boost::optional<Move> killers[max_ply][2];
+
+    int root(Color c, int depth, MoveList& moves,
+             const boost::optional<Move>& pv, boost::optional<Move>& best)
+    {
+        int scores[MoveList::capacity];
+        score_moves(moves, scores, 0, pv ? encode(*pv) : 0);
+        Color opp = c == WHITE ? BLACK : WHITE;
+        int alpha = -infinity;
+
+        for (int i = 0; i < moves.size; ++i) {
+            pick_next(moves, scores, i);
+            const Move& m = moves.moves[i];
+            Undo u = apply(board, m);
+            int score;
+            if (i == 0) {
+                score = -pvs(opp, depth - 1, 1, -infinity, -alpha);
+            } else {
+                score = -pvs(opp, depth - 1, 1, -alpha - 1, -alpha);
+                if (score > alpha && !stopped) {
+                    score = -pvs(opp, depth - 1, 1, -infinity, -alpha);
+                }
+            }
+            undo(board, m, u);
+            if (stopped) {
+                break;
+            }
+            if (score > alpha) {
+                alpha = score;
+                best = m;
+            }
+        }
+        return alpha;
+    }
+
+    int pvs(Color c, int depth, int ply, int alpha, int beta)
+    {
+        bool check = in_check(board, c);
+        if (check) {
+            ++depth;
+        }
+        if (depth <= 0 || ply >= max_ply) {
+            return quiesce(c, ply, alpha, beta);
+        }
+        if (out_of_time()) {
+            return 0;
+        }
+
+        uint64_t key = board.hash();
+        TranspositionTable::Entry entry;
+        uint16_t hash_move = 0;
+        if (tt.probe(key, entry)) {
+            hash_move = entry.move;
+            int score = from_table(entry.score, ply);
+            if (entry.depth >= depth && beta - alpha == 1 &&
+                (entry.bound == TranspositionTable::EXACT ||
+                 (entry.bound == TranspositionTable::LOWER && score >= beta) ||
+                 (entry.bound == TranspositionTable::UPPER && score <= alpha))) {
+                return score;
+            }
+        }
+
+        MoveList moves;
+        generate_legal_moves(board, c, moves);
+        if (moves.empty()) {
+            return check ? -mate_score + ply : 0;
+        }
+
+        int scores[MoveList::capacity];
+        score_moves(moves, scores, ply, hash_move);
+        Color opp = c == WHITE ? BLACK : WHITE;
+        int original_alpha = alpha;
+        uint16_t best_move = 0;
+
+        for (int i = 0; i < moves.size; ++i) {
+            pick_next(moves, scores, i);
+            const Move& m = moves.moves[i];
+            Undo u = apply(board, m);
+            int score;
+            if (i == 0) {
+                score = -pvs(opp, depth - 1, ply + 1, -beta, -alpha);
+            } else {
+                score = -pvs(opp, depth - 1, ply + 1, -alpha - 1, -alpha);
+                if (score > alpha && score < beta) {
+                    score = -pvs(opp, depth - 1, ply + 1, -beta, -alpha);
+                }
+            }
+            undo(board, m, u);
+            if (stopped) {
+                return 0;
+            }
+            if (score >= beta) {
+                if (!m.hit) {
+                    killers[ply][1] = killers[ply][0];
+                    killers[ply][0] = m;
+                }
+                store(key, encode(m), beta, depth, ply,
+                      TranspositionTable::LOWER);
+                return beta;
+            }
+            if (score > alpha) {
+                alpha = score;
+                best_move = encode(m);
+            }
+        }
+        store(key, best_move, alpha, depth, ply,
+              alpha > original_alpha ? TranspositionTable::EXACT :
+                                       TranspositionTable::UPPER);
+        return alpha;
+    }
+
+    int quiesce(Color c, int ply, int alpha, int beta)
+    {
+        if (out_of_time()) {
+            return 0;
+        }
+
+        int stand_pat = evaluate(board, c);
+        if (stand_pat >= beta || ply >= max_ply) {
+            return stand_pat;
+        }
+        alpha = std::max(alpha, stand_pat);
+
+        MoveList all, moves;
+        generate_legal_moves(board, c, all);
+        for (const Move& m : all) {
+            if (m.hit || is_promotion(m)) {
+                moves.push_back(m);
+            }
+        }
+
+        int scores[MoveList::capacity];
+        score_moves(moves, scores, ply, 0);
+        Color opp = c == WHITE ? BLACK : WHITE;
+
+        for (int i = 0; i < moves.size; ++i) {
+            pick_next(moves, scores, i);
+            const Move& m = moves.moves[i];
+            Undo u = apply(board, m);
+            int score = -quiesce(opp, ply + 1, -beta, -alpha);
+            undo(board, m, u);
+            if (stopped) {
+                return 0;
+            }
+            if (score >= beta) {
+                return beta;
+            }
+            alpha = std::max(alpha, score);
+        }
+        return alpha;
+    }
+
+    void store(uint64_t key, uint16_t move, int score, int depth, int ply,
+               TranspositionTable::Bound bound)
+    {
+        TranspositionTable::Entry e;
+        e.move = move;
+        e.score = to_table(score, ply);
+        e.depth = uint8_t(depth);
+        e.bound = uint8_t(bound);
+        tt.store(key, e);
+    }
+
+    bool out_of_time()
+    {
+        if ((++nodes & 1023) == 0 && thread == 0 &&
+            chrono::steady_clock::now() >= deadline) {
+            stop.store(true, std::memory_order_relaxed);
+        }
+        stopped = stop.load(std::memory_order_relaxed);
+        return stopped;
+    }
+
+    // PV or table move first, then captures by most valuable victim and
+    // least valuable attacker, promotions, killers and the rest.
+    void score_moves(const MoveList& moves, int* scores, int ply,
+                     uint16_t best)
+    {
+        for (int i = 0; i < moves.size; ++i) {
+            const Move& m = moves.moves[i];
+            int score = 0;
+            if (best && encode(m) == best) {
+                score = 1000000;
+            } else if (m.hit) {
+                Piece victim = board.piece_at(*m.hit)->piece;
+                Piece attacker = board.piece_at(endpoints(m).from)->piece;
+                score = 100000 + 10 * piece_value[victim] -
+                        piece_value[attacker] / 10;
+            } else if (is_promotion(m)) {
+                score = 90000;
+            } else if (killers[ply][0] &&
+                       encode(m) == encode(*killers[ply][0])) {
+                score = 80000;
+            } else if (killers[ply][1] &&
+                       encode(m) == encode(*killers[ply][1])) {
+                score = 70000;
+            }
+            scores[i] = score;
+        }
+    }
+
+    // Selection sort step, so cut-offs skip sorting the rest.
+    static void pick_next(MoveList& moves, int* scores, int i)
+    {
+        int best = i;
+        for (int j = i + 1; j < moves.size; ++j) {
+            if (scores[j] > scores[best]) {
+                best = j;
+            }
+        }
+        std::swap(moves.moves[i], moves.moves[best]);
+        std::swap(scores[i], scores[best]);
+    }
+};
+
+SearchResult search(Board b, Color c, SearchLimits limits)
+{
+    TranspositionTable tt(default_table_mb);
+    return search(b, c, limits, tt);
+}
+
+SearchResult search(Board b, Color c, SearchLimits limits,
+                    TranspositionTable& tt)
+{
+    tt.new_search();
+    std::atomic<bool> stop(false);
+    int threads = std::max(1, limits.threads);
+    std::vector<Board> boards(threads - 1, b);
+    std::vector<uint64_t> helper_nodes(threads - 1);
+
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threads; ++i) {
+        helpers.emplace_back([&, i]() {
+            Searcher helper(boards[i - 1], limits, tt, stop, i);
+            helper_nodes[i - 1] = helper.run(c).nodes;
+        });
+    }
+
+    SearchResult result = Searcher(b, limits, tt, stop, 0).run(c);
+    stop = true;
+    for (size_t i = 0; i < helpers.size(); ++i) {
+        helpers[i].join();
+        result.nodes += helper_nodes[i];
+    }
+    return result;
+}
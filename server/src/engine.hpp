@@ -0,0 +1,45 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include "chess.hpp"
+#include "tt.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+struct SearchLimits
+{
+    std::chrono::milliseconds time;
+    int max_depth;
+    // Lazy SMP: helpers search the same root and share the table; 0 is 1
+    int threads;
+};
+
+struct SearchResult
+{
+    boost::optional<Move> best;
+    int score;
+    int depth;
+    uint64_t nodes;
+    double seconds;
+};
+
+// Scores above this are mates; mate_score - n is mate in n plies.
+const int mate_score = 100000;
+
+// Static evaluation in centipawns from the point of view of the given side.
+int evaluate(const Board&, Color);
+
+// Principal variation search with iterative deepening, move ordering and
+// quiescence search. Returns the best move of the deepest completed
+// iteration that fit into the time budget; no move if the side to move has
+// none. Nodes are counted over all threads, seconds until the main thread
+// finished.
+//
+// Without a table a fresh one of default_table_mb is used.
+SearchResult search(Board, Color, SearchLimits);
+SearchResult search(Board, Color, SearchLimits, TranspositionTable&);
+
+const size_t default_table_mb = 16;
+
+#endif
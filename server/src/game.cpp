@@ -1,86 +1,212 @@
 #include "game.hpp"
 
-#include "server.hpp"
+#include "journal.hpp"
+#include "metrics.hpp"
+#include "room.hpp"
+#include "tablebase.hpp"
 #include <sstream>
-#include <boost/algorithm/string.hpp>
 
-Game::Game()
+Game::Game() :
+    player1(WHITE),
+    player2(BLACK),
+    current_color(WHITE),
+    tablebases(nullptr),
+    journal(nullptr),
+    journal_room(0)
 {
     reset_waiting();
 }
 
-void Game::message_handler(Server& server, int player, std::string msg)
+void Game::adjudicate_with(const Tablebases* tb)
 {
-    std::vector<std::string> words;
-    boost::trim(msg);
-    boost::split(words, msg, boost::is_any_of("\t "), boost::token_compress_on);
+    tablebases = tb;
+}
+
+void Game::journal_to(Journal* j, int room)
+{
+    journal = j;
+    journal_room = room;
+}
+
+void Game::resume(Color first, const Board& b, Color turn)
+{
+    playing = true;
+    ready1 = ready2 = true;
+    player1 = first;
+    player2 = first == WHITE ? BLACK : WHITE;
+    board = b;
+    current_color = turn;
+}
+
+static_assert(sizeof(GameSnapshot) == 56, "game snapshots are 56 bytes");
+
+GameSnapshot Game::snapshot() const
+{
+    GameSnapshot s = GameSnapshot();
+    s.board = ::snapshot(board);
+    s.playing = playing;
+    s.ready1 = ready1;
+    s.ready2 = ready2;
+    s.player1 = player1;
+    s.player2 = player2;
+    s.turn = current_color;
+    return s;
+}
 
-    if (words.empty()) {
-        error(server, player);
-        return;
+bool Game::restore(const GameSnapshot& s)
+{
+    auto b = from_snapshot(s.board);
+    if (!b || s.playing > 1 || s.ready1 > 1 || s.ready2 > 1 ||
+        s.player1 > BLACK || s.player2 > BLACK || s.turn > BLACK) {
+        return false;
     }
+    board = *b;
+    playing = s.playing;
+    ready1 = s.ready1;
+    ready2 = s.ready2;
+    player1 = Color(s.player1);
+    player2 = Color(s.player2);
+    current_color = Color(s.turn);
+    return true;
+}
+
+static Reply reply(ReplyType type)
+{
+    Reply r = Reply();
+    r.type = type;
+    return r;
+}
 
-    if (words[0] == "ready") {
+void Game::message_handler(Room& room, int player, const Command& cmd)
+{
+    switch (cmd.type) {
+    case READY: {
         if (ready(player)) {
-            error(server, player);
+            error(room, player);
             return;
         }
 
         ready(player) = true;
         player_color(player) = ready(other(player)) ? BLACK : WHITE;
-        server.send(player, "color " + show(player_color(player)));
+        Reply color = reply(ASSIGNED_COLOR);
+        color.color = player_color(player);
+        room.send(player, color);
 
         if (ready1 && ready2) {
             reset_playing();
-            server.broadcast("start");
+            room.broadcast(reply(STARTED));
         }
-    } else if (words[0] == "say") {
-        std::stringstream ss;
-        ss << "say" << player;
-        for (size_t i = 1; i < words.size(); ++i) {
-            ss << " " << words[i];
+        break;
+    }
+    case SAY: {
+        Reply said = reply(SAID);
+        said.player = player;
+        Tokenizer words(cmd.text);
+        boost::string_view word;
+        while (words.next(word)) {
+            if (!said.text.empty()) {
+                said.text += ' ';
+            }
+            said.text.append(word.data(), word.size());
         }
-        server.broadcast(ss.str());
-    } else if (words[0] == "move") {
+        room.broadcast(said);
+        break;
+    }
+    case MOVE: {
         if (!playing || current_color != player_color(player) ||
-            words.size() != 3) {
-            server.send(player, "error move");
+            cmd.args != 2) {
+            room.send(player, reply(BAD_MOVE));
             return;
         }
 
-        boost::optional<Square> maybe_from = read_square(words[1]);
-        boost::optional<Square> maybe_to = read_square(words[2]);
-        if (!maybe_from || !maybe_to) {
-            error(server, player);
+        if (!cmd.from || !cmd.to) {
+            error(room, player);
             return;
         }
 
+        auto started = metrics::Clock::now();
         boost::optional<MoveResult> maybe_move_result =
-            try_move(board, player_color(player), *maybe_from, *maybe_to);
+            try_move(board, player_color(player), *cmd.from, *cmd.to);
+        metrics::record(metrics::TRY_MOVE, metrics::Clock::now() - started);
         if (!maybe_move_result) {
-            server.send(player, "error move");
+            room.send(player, reply(BAD_MOVE));
             return;
         }
 
+        if (journal) {
+            journal->moved(journal_room, SimpleMove{*cmd.from, *cmd.to});
+        }
         current_color = current_color == WHITE ? BLACK : WHITE;
         if (maybe_move_result->opponent_cannot_move) {
-            reset_waiting();
+            game_over();
         }
 
-        server.broadcast(show(*maybe_move_result));
-    } else if (words[0] == "resign") {
+        Reply moved = reply(MOVED);
+        moved.result = *maybe_move_result;
+        room.broadcast(moved);
+
+        auto known = playing && tablebases ?
+                     tablebases->probe(board, current_color) : boost::none;
+        if (known) {
+            game_over();
+            Reply result = reply(ADJUDICATED);
+            result.draw = *known == 0;
+            result.color = *known > 0 ? current_color :
+                           current_color == WHITE ? BLACK : WHITE;
+            room.broadcast(result);
+        }
+        break;
+    }
+    case RESIGN:
         if (!playing || current_color != player_color(player)) {
-            error(server, player);
+            error(room, player);
             return;
         }
 
-        reset_waiting();
-        server.broadcast("resign");
+        game_over();
+        room.broadcast(reply(RESIGNED));
+        break;
+    case UNKNOWN:
+        error(room, player);
+        break;
+    }
+}
+
+void Game::player_left(Room& room, int player)
+{
+    if (playing) {
+        game_over();
+        room.broadcast(reply(RESIGNED));
     } else {
-        error(server, player);
+        ready(player) = false;
     }
 }
 
+bool Game::is_playing() const
+{
+    return playing;
+}
+
+bool Game::is_ready(int player) const
+{
+    return player == 1 ? ready1 : ready2;
+}
+
+Color Game::color(int player) const
+{
+    return player == 1 ? player1 : player2;
+}
+
+Color Game::turn() const
+{
+    return current_color;
+}
+
+const Board& Game::position() const
+{
+    return board;
+}
+
 void Game::reset_waiting()
 {
     playing = false;
@@ -92,6 +218,17 @@ void Game::reset_playing()
     playing = true;
     board = initial_position();
     current_color = WHITE;
+    if (journal) {
+        journal->started(journal_room, player1);
+    }
+}
+
+void Game::game_over()
+{
+    reset_waiting();
+    if (journal) {
+        journal->ended(journal_room);
+    }
 }
 
 bool& Game::ready(int player)
@@ -108,9 +245,9 @@ int Game::other(int player) {
     return 3 - player;
 }
 
-void Game::error(Server& server, int player) const
+void Game::error(Room& room, int player) const
 {
-    server.send(player, "error command");
+    room.send(player, reply(BAD_COMMAND));
 }
 
 std::string show(Color c)
@@ -162,7 +299,7 @@ struct ShowMoveVisitor : public boost::static_visitor<>
 
 std::string show(MoveResult mr)
 {
-    auto v = ShowMoveVisitor(mr.move.hit);
+    auto v = ShowMoveVisitor(!!mr.move.hit);
     boost::apply_visitor(v, mr.move.movement);
     std::string str = v.result;
     if (mr.gave_check) {
@@ -177,12 +314,100 @@ std::string show(MoveResult mr)
     return str;
 }
 
-boost::optional<Square> read_square(const std::string& str)
+std::string show(const Reply& r)
+{
+    switch (r.type) {
+    case ASSIGNED_COLOR:
+        return "color " + show(r.color);
+    case STARTED:
+        return "start";
+    case SAID:
+        return "say" + std::to_string(r.player) +
+               (r.text.empty() ? "" : " " + r.text);
+    case MOVED:
+        return show(r.result);
+    case RESIGNED:
+        return "resign";
+    case ADJUDICATED:
+        return "adjudicated " + (r.draw ? "draw" : show(r.color));
+    case BAD_COMMAND:
+        return "error command";
+    case BAD_MOVE:
+        return "error move";
+    }
+    return "";
+}
+
+boost::optional<Square> read_square(boost::string_view str)
 {
     if (str.size() != 2 || str[0] < 'a' || str[0] > 'z' ||
         str[1] < '1' || str[1] > '8') {
-        return boost::none_t();
+        return boost::none;
     }
 
     return Square{7 - (str[1] - '1'), str[0] - 'a'};
 }
+
+Command read_command(boost::string_view line)
+{
+    Command cmd = {UNKNOWN, 0, boost::none, boost::none, {}};
+    Tokenizer words(line);
+    boost::string_view word;
+    if (!words.next(word)) {
+        return cmd;
+    }
+
+    if (word == "ready") {
+        cmd.type = READY;
+    } else if (word == "say") {
+        cmd.type = SAY;
+        cmd.text = words.rest();
+        return cmd;
+    } else if (word == "move") {
+        cmd.type = MOVE;
+    } else if (word == "resign") {
+        cmd.type = RESIGN;
+    } else {
+        return cmd;
+    }
+
+    while (words.next(word)) {
+        if (cmd.type == MOVE && cmd.args == 0) {
+            cmd.from = read_square(word);
+        } else if (cmd.type == MOVE && cmd.args == 1) {
+            cmd.to = read_square(word);
+        }
+        ++cmd.args;
+    }
+    return cmd;
+}
+
+Tokenizer::Tokenizer(boost::string_view s) : str(s)
+{}
+
+bool Tokenizer::next(boost::string_view& word)
+{
+    skip_blanks();
+    if (str.empty()) {
+        return false;
+    }
+    size_t end = str.find_first_of(" \t\r\n");
+    if (end == boost::string_view::npos) {
+        end = str.size();
+    }
+    word = str.substr(0, end);
+    str.remove_prefix(end);
+    return true;
+}
+
+boost::string_view Tokenizer::rest()
+{
+    skip_blanks();
+    return str;
+}
+
+void Tokenizer::skip_blanks()
+{
+    size_t start = str.find_first_not_of(" \t\r\n");
+    str.remove_prefix(start == boost::string_view::npos ? str.size() : start);
+}
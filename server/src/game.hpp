@@ -2,15 +2,100 @@
 #define GAME_HPP
 
 #include "chess.hpp"
+#include "position.hpp"
 
-class Server;
+#include <string>
+#include <boost/utility/string_view.hpp>
 
+class Room;
+
+enum CommandType
+{
+    READY, SAY, MOVE, RESIGN, UNKNOWN
+};
+
+// A parsed protocol line. Views point into the line it was read from.
+struct Command
+{
+    CommandType type;
+    int args;
+    boost::optional<Square> from, to;
+    boost::string_view text;
+};
+
+enum ReplyType
+{
+    ASSIGNED_COLOR, STARTED, SAID, MOVED, RESIGNED, ADJUDICATED, BAD_COMMAND,
+    BAD_MOVE
+};
+
+// Something the game tells its players, before it is encoded for a
+// connection's protocol.
+struct Reply
+{
+    ReplyType type;
+    // the player's color, or the winner of an adjudicated game
+    Color color;
+    bool draw;
+    int player;
+    std::string text;
+    MoveResult result;
+};
+
+// Splits a line on blanks without copying it.
+class Tokenizer
+{
+public:
+    Tokenizer(boost::string_view);
+
+    bool next(boost::string_view&);
+    boost::string_view rest();
+private:
+    boost::string_view str;
+
+    void skip_blanks();
+};
+
+// Fixed-size image of a game's state, board included. Colors and flags
+// are a byte each.
+struct GameSnapshot
+{
+    BoardSnapshot board;
+    uint8_t playing, ready1, ready2, player1, player2, turn;
+    uint8_t reserved[2];
+};
+
+class Journal;
+class Tablebases;
+
+// With tablebases to adjudicate by, a game that reaches a position in them
+// ends there with the tables' result.
+//
+// With a journal, the game records its start, every move try_move accepted
+// and its end under the room's id, so it can be resumed after a restart.
 class Game
 {
 public:
     Game();
 
-    void message_handler(Server&, int player, std::string);
+    void adjudicate_with(const Tablebases*);
+    void journal_to(Journal*, int room);
+    // Continues a game recovered from a journal with both players ready.
+    void resume(Color player1, const Board&, Color turn);
+
+    GameSnapshot snapshot() const;
+    // Leaves the game as it was and returns false for a snapshot no game
+    // gives.
+    bool restore(const GameSnapshot&);
+
+    void message_handler(Room&, int player, const Command&);
+    void player_left(Room&, int player);
+
+    bool is_playing() const;
+    bool is_ready(int player) const;
+    Color color(int player) const;
+    Color turn() const;
+    const Board& position() const;
 private:
     bool playing;
 
@@ -20,21 +105,28 @@ private:
     Board board;
     Color current_color;
 
+    const Tablebases* tablebases;
+    Journal* journal;
+    int journal_room;
+
     void reset_waiting();
     void reset_playing();
+    void game_over();
 
     bool& ready(int);
     Color& player_color(int);
     int other(int);
 
-    void error(Server&, int player) const;
+    void error(Room&, int player) const;
 };
 
 std::string show(Color);
 std::string show(CastleDir);
 std::string show(Square);
 std::string show(MoveResult);
+std::string show(const Reply&);
 
-boost::optional<Square> read_square(const std::string&);
+boost::optional<Square> read_square(boost::string_view);
+Command read_command(boost::string_view);
 
 #endif
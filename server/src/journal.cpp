@@ -0,0 +1,303 @@
+#include "journal.hpp"
+
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+
+static_assert(sizeof(JournalRecord) == 8, "journal records are 8 bytes");
+
+static uint8_t checksum(const JournalRecord& r)
+{
+    return uint8_t(0x5a ^ r.room ^ r.room >> 8 ^ r.room >> 16 ^ r.room >> 24 ^
+                   r.type ^ r.a ^ r.b);
+}
+
+JournalRecord journal_record(int room, JournalRecord::Type type, uint8_t a,
+                             uint8_t b)
+{
+    JournalRecord r = {uint32_t(room), type, a, b, 0};
+    r.check = checksum(r);
+    return r;
+}
+
+static void write_all(int fd, const void* data, size_t size)
+{
+    const char* p = static_cast<const char*>(data);
+    while (size) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(std::string("journal write: ") +
+                                     std::strerror(errno));
+        }
+        p += n;
+        size -= n;
+    }
+}
+
+static std::vector<JournalRecord> records(
+        const std::vector<RecoveredGame>& games)
+{
+    std::vector<JournalRecord> out;
+    for (const RecoveredGame& g : games) {
+        out.push_back(journal_record(g.room, JournalRecord::START,
+                                     g.player1));
+        for (const SimpleMove& m : g.moves) {
+            out.push_back(journal_record(g.room, JournalRecord::MOVE,
+                                         square_index(m.from),
+                                         square_index(m.to)));
+        }
+    }
+    return out;
+}
+
+Journal::Journal(const std::string& path,
+                 const std::vector<RecoveredGame>& carried_over) :
+    fd(-1),
+    appended(0),
+    durable(0),
+    commit_count(0),
+    stopping(false)
+{
+    std::string fresh = path + ".new";
+    int out = open(fresh.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        throw std::runtime_error("cannot create " + fresh);
+    }
+    std::vector<JournalRecord> start = records(carried_over);
+    try {
+        write_all(out, start.data(), start.size() * sizeof(JournalRecord));
+    } catch (...) {
+        close(out);
+        throw;
+    }
+    if (fdatasync(out) != 0 || close(out) != 0 ||
+        std::rename(fresh.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("cannot replace " + path);
+    }
+
+    fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    committer = std::thread(&Journal::commit_loop, this);
+}
+
+Journal::~Journal()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    committer.join();
+    close(fd);
+}
+
+void Journal::started(int room, Color player1)
+{
+    append(journal_record(room, JournalRecord::START, player1));
+}
+
+void Journal::moved(int room, SimpleMove m)
+{
+    append(journal_record(room, JournalRecord::MOVE, square_index(m.from),
+                          square_index(m.to)));
+}
+
+void Journal::ended(int room)
+{
+    append(journal_record(room, JournalRecord::END));
+}
+
+// The committer only needs waking when it found nothing to do, which a
+// busy server rarely lets happen.
+void Journal::append(JournalRecord r)
+{
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++appended;
+        // counted, so sync reports it lost, but nothing will write it
+        if (!error.empty()) {
+            return;
+        }
+        was_empty = queued.empty();
+        queued.push_back(r);
+    }
+    if (was_empty) {
+        wake.notify_one();
+    }
+}
+
+void Journal::sync()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t target = appended;
+    committed.wait(lock, [&]() {
+        return durable >= target || !error.empty();
+    });
+    if (durable < target) {
+        throw std::runtime_error(error);
+    }
+}
+
+uint64_t Journal::commits()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return commit_count;
+}
+
+// Records keep arriving for a moment after the first one woke the
+// committer; waiting that long before writing makes commits larger and
+// spares the rooms most of the wake-ups.
+static const std::chrono::microseconds commit_delay(1000);
+
+void Journal::commit_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [&]() { return stopping || !queued.empty(); });
+        if (queued.empty()) {
+            return;
+        }
+        if (!stopping) {
+            lock.unlock();
+            std::this_thread::sleep_for(commit_delay);
+            lock.lock();
+        }
+        writing.swap(queued);
+        uint64_t target = appended;
+        lock.unlock();
+
+        std::string failure;
+        try {
+            write_all(fd, writing.data(),
+                      writing.size() * sizeof(JournalRecord));
+            if (fdatasync(fd) != 0) {
+                throw std::runtime_error(std::string("journal sync: ") +
+                                         std::strerror(errno));
+            }
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            failure = e.what();
+        }
+        writing.clear();
+
+        lock.lock();
+        if (!failure.empty()) {
+            error = failure;
+            queued.clear();
+            committed.notify_all();
+            return;
+        }
+        durable = target;
+        ++commit_count;
+        committed.notify_all();
+    }
+}
+
+static void replay(const JournalRecord* begin, const JournalRecord* end,
+                   int threads, int shard, std::vector<RecoveredGame>& out)
+{
+    std::unordered_map<uint32_t, RecoveredGame> live;
+    for (const JournalRecord* r = begin; r != end; ++r) {
+        if (int(r->room % threads) != shard) {
+            continue;
+        }
+        switch (r->type) {
+        case JournalRecord::START: {
+            RecoveredGame& g = live[r->room];
+            g.room = r->room;
+            g.player1 = r->a == BLACK ? BLACK : WHITE;
+            g.board = initial_position();
+            g.turn = WHITE;
+            g.moves.clear();
+            break;
+        }
+        case JournalRecord::MOVE: {
+            auto it = live.find(r->room);
+            if (it == live.end() || r->a >= 64 || r->b >= 64) {
+                break;
+            }
+            RecoveredGame& g = it->second;
+            SimpleMove m = {index_square(r->a), index_square(r->b)};
+            // a game whose moves stop making sense is not resumed
+            // checked as try_move would, without its look for the end of
+            // the game, which has a record of its own
+            auto legal = move(g.board, g.turn, m.from, m.to);
+            if (!legal) {
+                live.erase(it);
+                break;
+            }
+            apply(g.board, *legal);
+            g.turn = g.turn == WHITE ? BLACK : WHITE;
+            g.moves.push_back(m);
+            break;
+        }
+        case JournalRecord::END:
+            live.erase(r->room);
+            break;
+        }
+    }
+    for (auto& entry : live) {
+        out.push_back(std::move(entry.second));
+    }
+}
+
+std::vector<RecoveredGame> recover_journal(const std::string& path,
+                                           int threads)
+{
+    // neither a missing nor an empty file can be mapped
+    std::ifstream probe(path, std::ios::ate | std::ios::binary);
+    if (!probe || probe.tellg() <= 0) {
+        return {};
+    }
+
+    MappedFile file(path, MappedFile::SEQUENTIAL);
+    const JournalRecord* begin =
+        reinterpret_cast<const JournalRecord*>(file.data());
+    const JournalRecord* end = begin + file.size() / sizeof(JournalRecord);
+    for (const JournalRecord* r = begin; r != end; ++r) {
+        if (r->check != checksum(*r) || r->type < JournalRecord::START ||
+            r->type > JournalRecord::END) {
+            end = r;
+            break;
+        }
+    }
+
+    threads = std::max(1, threads);
+    std::vector<std::vector<RecoveredGame>> shards(threads);
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            replay(begin, end, threads, t, shards[t]);
+        });
+    }
+    replay(begin, end, threads, 0, shards[0]);
+    for (std::thread& t : pool) {
+        t.join();
+    }
+
+    std::vector<RecoveredGame> games;
+    for (auto& shard : shards) {
+        std::move(shard.begin(), shard.end(), std::back_inserter(games));
+    }
+    std::sort(games.begin(), games.end(),
+              [](const RecoveredGame& a, const RecoveredGame& b) {
+                  return a.room < b.room;
+              });
+    return games;
+}
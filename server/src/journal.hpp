@@ -0,0 +1,90 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include "chess.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One 8-byte journal record. START carries player 1's color in a, MOVE the
+// square indexes of the move as accepted by try_move in a and b. check
+// covers the other bytes so a record torn by a crash is recognized.
+struct JournalRecord
+{
+    enum Type : uint8_t { START = 1, MOVE, END };
+
+    uint32_t room;
+    Type type;
+    uint8_t a, b;
+    uint8_t check;
+};
+
+// A game that was started and not ended when the journal stopped.
+struct RecoveredGame
+{
+    int room;
+    Color player1;
+    Board board;
+    Color turn;
+    std::vector<SimpleMove> moves;
+};
+
+// Append-only write-ahead log of the games on this server.
+//
+// Appending only queues the record; a committer thread writes everything
+// queued since its last commit with one write and one fdatasync, so
+// however many rooms move at once, a commit costs two system calls. A
+// crash loses at most the last millisecond or so of records. After a
+// failed commit nothing more is written, as the file may end in a partial
+// write.
+class Journal
+{
+public:
+    // Starts the file over with the games carried over from the last run,
+    // replacing it atomically. Throws std::runtime_error if it cannot be
+    // written.
+    Journal(const std::string& path,
+            const std::vector<RecoveredGame>& carried_over);
+    // Commits what is queued.
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    void started(int room, Color player1);
+    void moved(int room, SimpleMove);
+    void ended(int room);
+
+    // Blocks until everything appended so far is on disk. Throws
+    // std::runtime_error if the journal failed before it got there.
+    void sync();
+    uint64_t commits();
+private:
+    int fd;
+    std::mutex mutex;
+    std::condition_variable wake, committed;
+    std::vector<JournalRecord> queued, writing;
+    uint64_t appended, durable, commit_count;
+    bool stopping;
+    // why the last commit failed, if it did
+    std::string error;
+    std::thread committer;
+
+    void append(JournalRecord);
+    void commit_loop();
+};
+
+JournalRecord journal_record(int room, JournalRecord::Type, uint8_t a = 0,
+                             uint8_t b = 0);
+
+// Replays the journal on the given number of threads, each taking the
+// rooms with its residue of the room id. Reading stops at the first torn
+// record; a missing file recovers nothing.
+std::vector<RecoveredGame> recover_journal(const std::string& path,
+                                           int threads);
+
+#endif
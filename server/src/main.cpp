@@ -1,15 +1,104 @@
-#include "game.hpp"
+#include "book.hpp"
+#include "journal.hpp"
 #include "server.hpp"
+#include "tablebase.hpp"
 
-using namespace std::placeholders;
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main() {
-    Game game;
-    boost::asio::io_service io;
-    Server server(io);
-    server.set_read_callback(
-            std::bind(&Game::message_handler, game, _1, _2, _3));
+// bin/server [--book file] [--tablebases dir [--adjudicate]]
+//            [--journal file] [--stats-port port]
+//            [threads] [engine_threads] [search_threads]
+int main(int argc, char** argv) {
+    std::vector<int> counts;
+    std::unique_ptr<OpeningBook> book;
+    std::string journal_path;
+    int stats_port = 0;
+    Tablebases tablebases;
+    int tables = 0;
+    bool adjudicate = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--book" && i + 1 < argc) {
+                book.reset(new OpeningBook(argv[++i]));
+                std::cout << "Opening book with " << book->size()
+                          << " moves.\n";
+            } else if (arg == "--tablebases" && i + 1 < argc) {
+                tables = tablebases.load(argv[++i]);
+                std::cout << "Loaded " << tables << " tablebases.\n";
+            } else if (arg == "--journal" && i + 1 < argc) {
+                journal_path = argv[++i];
+            } else if (arg == "--stats-port" && i + 1 < argc) {
+                stats_port = std::atoi(argv[++i]);
+            } else if (arg == "--adjudicate") {
+                adjudicate = true;
+            } else {
+                counts.push_back(std::atoi(arg.c_str()));
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    auto count = [&counts](size_t i, int fallback) {
+        return std::max(1, i < counts.size() ? counts[i] : fallback);
+    };
+    int threads = count(0, int(std::thread::hardware_concurrency()));
+    int engine_threads = count(1, 1);
+    int search_threads = count(2, 1);
+
+    std::vector<RecoveredGame> recovered;
+    std::unique_ptr<Journal> journal;
+    if (!journal_path.empty()) {
+        try {
+            auto begin = std::chrono::steady_clock::now();
+            recovered = recover_journal(journal_path, threads);
+            std::chrono::duration<double> took =
+                std::chrono::steady_clock::now() - begin;
+            std::cout << "Recovered " << recovered.size() << " games in "
+                      << took.count() << " s.\n";
+            journal.reset(new Journal(journal_path, recovered));
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    boost::asio::io_service io, engine_io;
+    boost::asio::io_service::work engine_work(engine_io);
+    EngineConfig engine = {&engine_io, search_threads, book.get(),
+                           tables ? &tablebases : nullptr};
+    Server server(io, engine, adjudicate && tables ? &tablebases : nullptr);
+    server.journal_to(journal.get());
+    server.resume(recovered);
+    if (stats_port > 0 && stats_port < 65536) {
+        try {
+            server.serve_stats((unsigned short)stats_port);
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
     server.run();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < engine_threads; ++i) {
+        workers.emplace_back([&engine_io]() { engine_io.run(); });
+    }
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back([&io]() { io.run(); });
+    }
     io.run();
+    engine_io.stop();
+    for (std::thread& t : workers) {
+        t.join();
+    }
     return 0;
 }
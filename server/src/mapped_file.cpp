@@ -0,0 +1,55 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path, Access access) :
+    mapping(MAP_FAILED),
+    mapping_size(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        mapping_size = st.st_size;
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("cannot map " + path);
+    }
+    madvise(mapping, mapping_size,
+            access == RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(mapping, mapping_size);
+}
+
+const char* MappedFile::data() const
+{
+    return static_cast<const char*>(mapping);
+}
+
+size_t MappedFile::size() const
+{
+    return mapping_size;
+}
+
+void MappedFile::release(size_t offset, size_t length) const
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = std::min(offset + length, mapping_size) / page * page;
+    if (begin < end) {
+        madvise(static_cast<char*>(mapping) + begin, end - begin,
+                MADV_DONTNEED);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+// A whole file mapped read-only and shared, so every process mapping it
+// reads the same page cache copy. Mapping costs the same whatever the file
+// size; pages are read when first touched.
+class MappedFile
+{
+public:
+    enum Access { RANDOM, SEQUENTIAL };
+
+    // Throws std::runtime_error if the file cannot be opened or mapped.
+    MappedFile(const std::string& path, Access);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const;
+    size_t size() const;
+    // Drops the pages wholly inside the range from memory; reading them
+    // again reads them back in. Lets a pass over a large file run in
+    // bounded memory.
+    void release(size_t offset, size_t length) const;
+private:
+    void* mapping;
+    size_t mapping_size;
+};
+
+#endif
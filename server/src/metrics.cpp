@@ -0,0 +1,202 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <vector>
+
+namespace metrics
+{
+
+Histogram::Histogram()
+{
+    for (auto& c : counts) {
+        c.store(0, std::memory_order_relaxed);
+    }
+}
+
+int Histogram::bucket(uint64_t ns)
+{
+    if (ns < 16) {
+        return int(ns);
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    return (exponent - 3) * 16 + int(ns >> (exponent - 4) & 15);
+}
+
+uint64_t Histogram::lower_bound(int bucket)
+{
+    if (bucket < 16) {
+        return uint64_t(bucket);
+    }
+    int exponent = bucket / 16 + 3;
+    return uint64_t(16 + bucket % 16) << (exponent - 4);
+}
+
+static void bump(std::atomic<uint64_t>& c, uint64_t n)
+{
+    c.store(c.load(std::memory_order_relaxed) + n,
+            std::memory_order_relaxed);
+}
+
+void Histogram::record(uint64_t ns)
+{
+    bump(counts[bucket(ns)], 1);
+}
+
+void Histogram::add_to(std::array<uint64_t, buckets>& totals) const
+{
+    for (int i = 0; i < buckets; ++i) {
+        totals[i] += counts[i].load(std::memory_order_relaxed);
+    }
+}
+
+struct ThreadMetrics
+{
+    std::atomic<uint64_t> counters[COUNTERS];
+    Histogram timings[TIMINGS];
+};
+
+struct Free
+{
+    void operator()(ThreadMetrics* m) const
+    {
+        m->~ThreadMetrics();
+        std::free(m);
+    }
+};
+
+// Never destroyed, so threads still running at exit can record.
+static std::mutex& registry_mutex = *new std::mutex;
+static std::vector<std::unique_ptr<ThreadMetrics, Free>>& registry =
+    *new std::vector<std::unique_ptr<ThreadMetrics, Free>>;
+
+// Cache-line aligned, so no other thread's writes share its lines.
+static ThreadMetrics* enroll()
+{
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 64, sizeof(ThreadMetrics)) != 0) {
+        throw std::bad_alloc();
+    }
+    ThreadMetrics* m = new (memory) ThreadMetrics;
+    for (auto& c : m->counters) {
+        c.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.emplace_back(m);
+    return m;
+}
+
+static ThreadMetrics& local()
+{
+    thread_local ThreadMetrics* mine = enroll();
+    return *mine;
+}
+
+void add(Counter c, uint64_t n)
+{
+    bump(local().counters[c], n);
+}
+
+void record(Timing t, Clock::duration d)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d);
+    local().timings[t].record(uint64_t(std::max<int64_t>(0, ns.count())));
+}
+
+static const char* const counter_names[COUNTERS] = {
+    "connections_opened", "connections_closed", "rooms_opened",
+    "rooms_closed", "bytes_in", "bytes_out"
+};
+
+// the command label is left out where there is none
+static const struct
+{
+    const char* metric;
+    const char* command;
+} timing_names[TIMINGS] = {
+    {"command_latency_us", "ready"}, {"command_latency_us", "say"},
+    {"command_latency_us", "move"}, {"command_latency_us", "resign"},
+    {"try_move_us", nullptr}
+};
+
+static std::string labels(Timing t, const std::string& quantile)
+{
+    std::string l;
+    if (timing_names[t].command) {
+        l = std::string("command=\"") + timing_names[t].command + "\"";
+    }
+    if (!quantile.empty()) {
+        l += (l.empty() ? "" : ",") + ("quantile=\"" + quantile + "\"");
+    }
+    return l.empty() ? l : "{" + l + "}";
+}
+
+static const char* const quantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+
+// The middle of the bucket the quantile falls in.
+static double quantile(const std::array<uint64_t, Histogram::buckets>& counts,
+                       uint64_t total, double q)
+{
+    uint64_t rank = uint64_t(q * (total - 1)), seen = 0;
+    for (int i = 0; i < Histogram::buckets; ++i) {
+        seen += counts[i];
+        if (seen > rank) {
+            uint64_t low = Histogram::lower_bound(i);
+            uint64_t high = i + 1 < Histogram::buckets ?
+                            Histogram::lower_bound(i + 1) : low + 1;
+            return (low + high - 1) / 2.0 / 1000;
+        }
+    }
+    return 0;
+}
+
+std::string report()
+{
+    uint64_t counters[COUNTERS] = {};
+    std::vector<std::array<uint64_t, Histogram::buckets>> counts(TIMINGS);
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (const auto& m : registry) {
+            for (int c = 0; c < COUNTERS; ++c) {
+                counters[c] +=
+                    m->counters[c].load(std::memory_order_relaxed);
+            }
+            for (int t = 0; t < TIMINGS; ++t) {
+                m->timings[t].add_to(counts[t]);
+            }
+        }
+    }
+
+    std::ostringstream out;
+    for (int c = 0; c < COUNTERS; ++c) {
+        out << counter_names[c] << " " << counters[c] << "\n";
+    }
+    // a close can be seen before the open it follows, from another thread
+    auto active = [&](Counter opened, Counter closed) {
+        return std::max<int64_t>(0, int64_t(counters[opened] -
+                                            counters[closed]));
+    };
+    out << "connections_active "
+        << active(CONNECTIONS_OPENED, CONNECTIONS_CLOSED) << "\n"
+        << "rooms_active " << active(ROOMS_OPENED, ROOMS_CLOSED) << "\n";
+    for (int t = 0; t < TIMINGS; ++t) {
+        uint64_t total = 0;
+        for (uint64_t n : counts[t]) {
+            total += n;
+        }
+        for (const char* q : quantiles) {
+            out << timing_names[t].metric << labels(Timing(t), q) << " "
+                << (total ? quantile(counts[t], total, std::atof(q)) : 0)
+                << "\n";
+        }
+        out << timing_names[t].metric << "_count" << labels(Timing(t), "")
+            << " " << total << "\n";
+    }
+    return out.str();
+}
+
+}
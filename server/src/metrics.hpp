@@ -0,0 +1,64 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Counters and latency histograms of the server.
+//
+// Every thread records into a block of its own, kept on cache lines no
+// other thread writes, with relaxed loads and stores instead of atomic
+// read-modify-writes. Reading sums the blocks of all threads, including
+// threads that have exited, so totals never go down.
+
+namespace metrics
+{
+
+enum Counter
+{
+    CONNECTIONS_OPENED, CONNECTIONS_CLOSED, ROOMS_OPENED, ROOMS_CLOSED,
+    BYTES_IN, BYTES_OUT, COUNTERS
+};
+
+// The command latencies run from handling a command to the end of the
+// first write to its connection after it, which carries the reply.
+enum Timing
+{
+    READY_LATENCY, SAY_LATENCY, MOVE_LATENCY, RESIGN_LATENCY, TRY_MOVE,
+    TIMINGS
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// Nanoseconds in logarithmic buckets: exact below 16, then 16 buckets for
+// every power of two, so a value is known to within 1/16.
+class Histogram
+{
+public:
+    static const int buckets = 976;
+
+    Histogram();
+
+    // Only the owning thread records.
+    void record(uint64_t nanoseconds);
+    void add_to(std::array<uint64_t, buckets>& totals) const;
+
+    static int bucket(uint64_t nanoseconds);
+    static uint64_t lower_bound(int bucket);
+private:
+    std::atomic<uint64_t> counts[buckets];
+};
+
+void add(Counter, uint64_t n = 1);
+void record(Timing, Clock::duration);
+
+// "name value" lines for a scraper, latencies as summaries in
+// microseconds.
+std::string report();
+
+}
+
+#endif
@@ -0,0 +1,207 @@
+#include "pgn.hpp"
+
+#include "game.hpp"
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool ends_token(char c)
+{
+    return is_blank(c) || c == '{' || c == '}' || c == '(' || c == ')' ||
+           c == '[' || c == ']' || c == ';';
+}
+
+static bool is_result(boost::string_view token)
+{
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+           token == "*";
+}
+
+PgnReader::PgnReader(boost::string_view text) :
+    text(text),
+    pos(0)
+{}
+
+bool PgnReader::next_game(std::vector<boost::string_view>& moves)
+{
+    moves.clear();
+    last_result.clear();
+    bool in_movetext = false;
+    while (pos < text.size()) {
+        char c = text[pos];
+        if (is_blank(c)) {
+            ++pos;
+        } else if (c == '[') {
+            // the tags of the next game; the last one had no result
+            if (in_movetext) {
+                return true;
+            }
+            skip_past('\n');
+        } else if (c == '{') {
+            skip_past('}');
+        } else if (c == ';' || (c == '%' && (pos == 0 ||
+                                             text[pos - 1] == '\n'))) {
+            skip_past('\n');
+        } else if (c == '(') {
+            skip_variation();
+        } else {
+            size_t start = pos;
+            while (pos < text.size() && !ends_token(text[pos])) {
+                ++pos;
+            }
+            if (pos == start) {
+                ++pos;
+                continue;
+            }
+            boost::string_view token = text.substr(start, pos - start);
+            in_movetext = true;
+            if (is_result(token)) {
+                last_result = token;
+                return true;
+            }
+            if (token[0] == '$') {
+                continue;
+            }
+            // "12." and "12..." as well as "12.e4"
+            size_t move = 0;
+            while (move < token.size() &&
+                   ((token[move] >= '0' && token[move] <= '9' &&
+                     token.find('.') != boost::string_view::npos) ||
+                    token[move] == '.')) {
+                ++move;
+            }
+            if (move < token.size()) {
+                moves.push_back(token.substr(move));
+            }
+        }
+    }
+    return in_movetext;
+}
+
+boost::string_view PgnReader::result() const
+{
+    return last_result;
+}
+
+size_t PgnReader::position() const
+{
+    return pos;
+}
+
+void PgnReader::skip_past(char end)
+{
+    size_t found = text.find(end, pos);
+    pos = found == boost::string_view::npos ? text.size() : found + 1;
+}
+
+void PgnReader::skip_variation()
+{
+    int nesting = 0;
+    while (pos < text.size()) {
+        char c = text[pos++];
+        if (c == '(') {
+            ++nesting;
+        } else if (c == ')' && --nesting == 0) {
+            return;
+        } else if (c == '{') {
+            skip_past('}');
+        }
+    }
+}
+
+static boost::optional<Piece> read_piece(char c)
+{
+    switch (c) {
+    case 'K': return KING;
+    case 'Q': return QUEEN;
+    case 'R': return ROOK;
+    case 'B': return BISHOP;
+    case 'N': return KNIGHT;
+    default: return boost::none;
+    }
+}
+
+boost::optional<Move> read_san(Board& b, Color c, boost::string_view san)
+{
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' ||
+                            san.back() == '!' || san.back() == '?')) {
+        san.remove_suffix(1);
+    }
+
+    // only the pieces that could make the move are tried, each by move(),
+    // rather than generating every legal move of the position
+    bool kingside = san == "O-O" || san == "0-0";
+    if (kingside || san == "O-O-O" || san == "0-0-0") {
+        if (!b.pieces(c, KING)) {
+            return boost::none;
+        }
+        Square king = b.king_pos(c);
+        auto m = move(b, c, king, {king.row, king.col + (kingside ? 2 : -2)});
+        if (!m || !boost::get<Castle>(&m->movement)) {
+            return boost::none;
+        }
+        return m;
+    }
+
+    Piece piece = PAWN;
+    if (!san.empty() && read_piece(san[0])) {
+        piece = *read_piece(san[0]);
+        san.remove_prefix(1);
+    }
+
+    // only queen promotions exist here
+    size_t promotion = san.find('=');
+    if (promotion == boost::string_view::npos && !san.empty() &&
+        read_piece(san.back())) {
+        promotion = san.size() - 1;
+    }
+    if (promotion != boost::string_view::npos) {
+        boost::string_view to_piece = san.substr(promotion);
+        if (to_piece != "=Q" && to_piece != "Q") {
+            return boost::none;
+        }
+        san = san.substr(0, promotion);
+    }
+
+    if (san.size() < 2) {
+        return boost::none;
+    }
+    auto to = read_square(san.substr(san.size() - 2));
+    if (!to) {
+        return boost::none;
+    }
+    int from_col = -1, from_row = -1;
+    for (char d : san.substr(0, san.size() - 2)) {
+        if (d >= 'a' && d <= 'h') {
+            from_col = d - 'a';
+        } else if (d >= '1' && d <= '8') {
+            from_row = 8 - (d - '0');
+        } else if (d != 'x') {
+            return boost::none;
+        }
+    }
+
+    Move found;
+    int candidates = 0;
+    for (Bitboard bb = b.pieces(c, piece); bb; bb &= bb - 1) {
+        Square from = index_square(__builtin_ctzll(bb));
+        if ((from_col >= 0 && from.col != from_col) ||
+            (from_row >= 0 && from.row != from_row)) {
+            continue;
+        }
+        auto m = move(b, c, from, *to);
+        if (!m || boost::get<Castle>(&m->movement)) {
+            continue;
+        }
+        if (++candidates > 1) {
+            return boost::none;
+        }
+        found = *m;
+    }
+    if (!candidates) {
+        return boost::none;
+    }
+    return found;
+}
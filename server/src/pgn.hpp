@@ -0,0 +1,38 @@
+#ifndef PGN_HPP
+#define PGN_HPP
+
+#include "chess.hpp"
+
+#include <vector>
+#include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
+
+// Splits PGN text into the movetext of its games. Tag pairs, comments,
+// variations, NAGs and move numbers are skipped; the moves are views into
+// the text.
+class PgnReader
+{
+public:
+    explicit PgnReader(boost::string_view text);
+
+    // False once the text is used up.
+    bool next_game(std::vector<boost::string_view>& moves);
+    // The result token that ended the last game, empty if it had none.
+    boost::string_view result() const;
+    // Where in the text the next game will be read from.
+    size_t position() const;
+private:
+    boost::string_view text;
+    size_t pos;
+    boost::string_view last_result;
+
+    void skip_past(char);
+    void skip_variation();
+};
+
+// Resolves a move in standard algebraic notation ("Nbd7", "exd5", "O-O",
+// "e8=Q+") against the legal moves of the position. Moves the rules engine
+// does not know, such as underpromotions, give none.
+boost::optional<Move> read_san(Board&, Color, boost::string_view);
+
+#endif
@@ -0,0 +1,206 @@
+#include "position.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+static_assert(sizeof(BoardSnapshot) == 48, "snapshots are 48 bytes");
+
+const char* const initial_fen =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static const char piece_letters[] = "kqrbnp";
+
+// The squares of the king and rook that each castling letter stands for,
+// as in castling_rights.
+static const struct
+{
+    char letter;
+    Color color;
+    int king, rook;
+} castles[4] = {
+    {'K', WHITE, 60, 63}, {'Q', WHITE, 60, 56},
+    {'k', BLACK, 4, 7}, {'q', BLACK, 4, 0}
+};
+
+static const Bitboard pawn_rows = Bitboard(0xff) << 8 | Bitboard(0xff) << 48;
+static const Bitboard back_rows = Bitboard(0xff) | Bitboard(0xff) << 56;
+
+// One king a side and no pawn on a back row, as in every game; the rules
+// assume both.
+static bool playable(const Board& b)
+{
+    return __builtin_popcountll(b.pieces(WHITE, KING)) == 1 &&
+           __builtin_popcountll(b.pieces(BLACK, KING)) == 1 &&
+           !((b.pieces(WHITE, PAWN) | b.pieces(BLACK, PAWN)) & back_rows);
+}
+
+static bool has(const Board& b, ColoredPiece cp, int index)
+{
+    return b.pieces(cp.color, cp.piece) >> index & 1;
+}
+
+static boost::string_view next_field(boost::string_view& text)
+{
+    while (!text.empty() && text.front() == ' ') {
+        text.remove_prefix(1);
+    }
+    size_t end = std::min(text.find(' '), text.size());
+    boost::string_view field = text.substr(0, end);
+    text.remove_prefix(end);
+    return field;
+}
+
+boost::optional<Board> from_fen(boost::string_view text)
+{
+    Board b;
+    boost::string_view placement = next_field(text);
+    int row = 0, col = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            if (col != 8 || ++row > 7) {
+                return boost::none;
+            }
+            col = 0;
+        } else if (c >= '1' && c <= '8') {
+            col += c - '0';
+            if (col > 8) {
+                return boost::none;
+            }
+        } else {
+            char lower = c | 0x20;
+            const char* p = std::char_traits<char>::find(piece_letters, 6,
+                                                         lower);
+            if (!p || col > 7) {
+                return boost::none;
+            }
+            Color color = c == lower ? BLACK : WHITE;
+            b.put({color, Piece(p - piece_letters)}, {row, col++});
+        }
+    }
+    if (row != 7 || col != 8 || !playable(b)) {
+        return boost::none;
+    }
+
+    boost::string_view side = next_field(text);
+    if (side != "w" && side != "b") {
+        return boost::none;
+    }
+
+    Bitboard unmoved = (b.pieces(WHITE, PAWN) | b.pieces(BLACK, PAWN)) &
+                       pawn_rows;
+    boost::string_view rights = next_field(text);
+    if (rights != "-") {
+        for (char c : rights) {
+            auto castle = std::find_if(std::begin(castles), std::end(castles),
+                                       [c](decltype(castles[0]) k) {
+                                           return k.letter == c;
+                                       });
+            if (castle == std::end(castles) ||
+                !has(b, {castle->color, KING}, castle->king) ||
+                !has(b, {castle->color, ROOK}, castle->rook)) {
+                return boost::none;
+            }
+            unmoved |= Bitboard(1) << castle->king |
+                       Bitboard(1) << castle->rook;
+        }
+    }
+    b.set_unmoved(unmoved);
+    if (side == "b") {
+        b.flip_side();
+    }
+    return b;
+}
+
+std::string to_fen(const Board& b)
+{
+    std::string fen;
+    fen.reserve(90);
+    for (int row = 0; row < 8; ++row) {
+        int empty = 0;
+        for (int col = 0; col < 8; ++col) {
+            auto cp = b.piece_at({row, col});
+            if (!cp) {
+                ++empty;
+                continue;
+            }
+            if (empty) {
+                fen += char('0' + empty);
+                empty = 0;
+            }
+            char letter = piece_letters[cp->piece];
+            fen += cp->color == WHITE ? char(letter - 0x20) : letter;
+        }
+        if (empty) {
+            fen += char('0' + empty);
+        }
+        if (row < 7) {
+            fen += '/';
+        }
+    }
+
+    fen += b.side_to_move() == WHITE ? " w " : " b ";
+    size_t rights = fen.size();
+    Bitboard unmoved = b.unmoved_pieces();
+    for (const auto& castle : castles) {
+        if (unmoved >> castle.king & 1 && unmoved >> castle.rook & 1 &&
+            has(b, {castle.color, KING}, castle.king) &&
+            has(b, {castle.color, ROOK}, castle.rook)) {
+            fen += castle.letter;
+        }
+    }
+    if (fen.size() == rights) {
+        fen += '-';
+    }
+    fen += " - 0 1";
+    return fen;
+}
+
+BoardSnapshot snapshot(const Board& b)
+{
+    BoardSnapshot s = BoardSnapshot();
+    for (int c = WHITE; c <= BLACK; ++c) {
+        for (int p = KING; p <= PAWN; ++p) {
+            for (Bitboard bb = b.pieces(Color(c), Piece(p)); bb;
+                 bb &= bb - 1) {
+                int i = __builtin_ctzll(bb);
+                s.squares[i / 2] |= (1 + c * 6 + p) << (i % 2 * 4);
+            }
+        }
+    }
+    Bitboard unmoved = b.unmoved_pieces();
+    for (int i = 0; i < 8; ++i) {
+        s.unmoved[i] = uint8_t(unmoved >> (8 * i));
+    }
+    s.side = uint8_t(b.side_to_move());
+    return s;
+}
+
+boost::optional<Board> from_snapshot(const BoardSnapshot& s)
+{
+    if (s.side > BLACK) {
+        return boost::none;
+    }
+    Board b;
+    for (int i = 0; i < 64; ++i) {
+        int code = s.squares[i / 2] >> (i % 2 * 4) & 15;
+        if (code > 12) {
+            return boost::none;
+        }
+        if (code) {
+            --code;
+            b.put({Color(code / 6), Piece(code % 6)}, index_square(i));
+        }
+    }
+    if (!playable(b)) {
+        return boost::none;
+    }
+    Bitboard unmoved = 0;
+    for (int i = 0; i < 8; ++i) {
+        unmoved |= Bitboard(s.unmoved[i]) << (8 * i);
+    }
+    b.set_unmoved(unmoved);
+    if (s.side == BLACK) {
+        b.flip_side();
+    }
+    return b;
+}
@@ -0,0 +1,38 @@
+#ifndef POSITION_HPP
+#define POSITION_HPP
+
+#include "chess.hpp"
+
+#include <cstdint>
+#include <string>
+#include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
+
+// Forsyth-Edwards Notation. The castling field marks kings and rooks as
+// unmoved and pawns on their starting row are unmoved as well, which is
+// what the rules here go by. Since there is no en passant and no clocks,
+// reading ignores the en passant and clock fields, which may be left out,
+// and writing gives "- 0 1". Malformed text, castling rights without their
+// pieces, a missing king and pawns on a back row read as none.
+boost::optional<Board> from_fen(boost::string_view);
+std::string to_fen(const Board&);
+
+extern const char* const initial_fen;
+
+// Fixed-size image of a board: a nibble per square (0 for empty, otherwise
+// 1 + color * 6 + piece, the low nibble first), the unmoved flags as a
+// little-endian bitboard and the side to move. The hash is recomputed on
+// the way back.
+struct BoardSnapshot
+{
+    uint8_t squares[32];
+    uint8_t unmoved[8];
+    uint8_t side;
+    uint8_t reserved[7];
+};
+
+BoardSnapshot snapshot(const Board&);
+// None for a snapshot no game gives.
+boost::optional<Board> from_snapshot(const BoardSnapshot&);
+
+#endif
@@ -0,0 +1,127 @@
+#include "protocol.hpp"
+
+namespace binary
+{
+
+struct MoveFlagsVisitor : public boost::static_visitor<int>
+{
+    int operator()(const SimpleMove&) const
+    {
+        return 0;
+    }
+
+    int operator()(const Castle&) const
+    {
+        return CASTLE;
+    }
+
+    int operator()(const Promotion&) const
+    {
+        return PROMOTION;
+    }
+};
+
+size_t payload_size(const char* data)
+{
+    return size_t(uint8_t(data[0])) << 8 | uint8_t(data[1]);
+}
+
+static int move_flags(const MoveResult& mr)
+{
+    int flags = boost::apply_visitor(MoveFlagsVisitor(), mr.move.movement);
+    if (mr.move.hit) {
+        flags |= HIT;
+    }
+    if (mr.gave_check) {
+        flags |= CHECK;
+    }
+    if (mr.opponent_cannot_move) {
+        flags |= CANNOT_MOVE;
+    }
+    return flags;
+}
+
+std::string encode(const Reply& r)
+{
+    std::string frame(header_size, '\0');
+    switch (r.type) {
+    case ASSIGNED_COLOR:
+        frame += char(OP_COLOR);
+        frame += char(r.color);
+        break;
+    case STARTED:
+        frame += char(OP_START);
+        break;
+    case SAID:
+        frame += char(OP_SAID);
+        frame += char(r.player);
+        frame.append(r.text, 0, max_payload - 2);
+        break;
+    case MOVED: {
+        SimpleMove ends = endpoints(r.result.move);
+        frame += char(OP_MOVED);
+        frame += char(square_index(ends.from));
+        frame += char(square_index(ends.to));
+        frame += char(move_flags(r.result));
+        break;
+    }
+    case RESIGNED:
+        frame += char(OP_RESIGNED);
+        break;
+    case ADJUDICATED:
+        frame += char(OP_ADJUDICATED);
+        frame += char(r.draw ? adjudicated_draw : r.color);
+        break;
+    case BAD_COMMAND:
+        frame += char(OP_ERROR_COMMAND);
+        break;
+    case BAD_MOVE:
+        frame += char(OP_ERROR_MOVE);
+        break;
+    }
+    size_t size = frame.size() - header_size;
+    frame[0] = char(size >> 8);
+    frame[1] = char(size & 0xff);
+    return frame;
+}
+
+static boost::optional<Square> read_square(char c)
+{
+    int i = uint8_t(c);
+    if (i >= 64) {
+        return boost::none;
+    }
+    return index_square(i);
+}
+
+Command read_frame(boost::string_view payload)
+{
+    Command cmd = {UNKNOWN, 0, boost::none, boost::none, {}};
+    if (payload.empty()) {
+        return cmd;
+    }
+
+    switch (uint8_t(payload[0])) {
+    case OP_READY:
+        cmd.type = READY;
+        break;
+    case OP_SAY:
+        cmd.type = SAY;
+        cmd.text = payload.substr(1);
+        break;
+    case OP_MOVE:
+        cmd.type = MOVE;
+        cmd.args = int(payload.size()) - 1;
+        if (cmd.args == 2) {
+            cmd.from = read_square(payload[1]);
+            cmd.to = read_square(payload[2]);
+        }
+        break;
+    case OP_RESIGN:
+        cmd.type = RESIGN;
+        break;
+    }
+    return cmd;
+}
+
+}
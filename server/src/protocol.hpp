@@ -0,0 +1,53 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include "game.hpp"
+
+#include <string>
+#include <boost/utility/string_view.hpp>
+
+// Binary framing, chosen by a client that sends the line "binary" before
+// anything else. The server answers "binary" and from then on both sides
+// send frames: a big-endian 16-bit payload length, then the payload, whose
+// first byte is the opcode. Squares are one byte, row * 8 + col.
+//
+// client: READY | SAY text | MOVE from to | RESIGN
+// server: COLOR color | START | SAY player text | MOVE from to flags |
+//         RESIGN | ERROR_COMMAND | ERROR_MOVE | ADJUDICATED result
+//
+// The result of ADJUDICATED is the winner's color, or 2 for a draw.
+
+namespace binary
+{
+
+enum ClientOp
+{
+    OP_READY = 1, OP_SAY, OP_MOVE, OP_RESIGN
+};
+
+enum ServerOp
+{
+    OP_COLOR = 1, OP_START, OP_SAID, OP_MOVED, OP_RESIGNED,
+    OP_ERROR_COMMAND, OP_ERROR_MOVE, OP_ADJUDICATED
+};
+
+const int adjudicated_draw = 2;
+
+// flags of OP_MOVED; checkmate is CHECK | CANNOT_MOVE
+enum MoveFlag
+{
+    HIT = 1, PROMOTION = 2, CASTLE = 4, CHECK = 8, CANNOT_MOVE = 16
+};
+
+const size_t header_size = 2;
+const size_t max_payload = 1024;
+
+// Length of the payload announced by the header at the start of data.
+size_t payload_size(const char* data);
+
+std::string encode(const Reply&);
+Command read_frame(boost::string_view payload);
+
+}
+
+#endif
@@ -0,0 +1,250 @@
+#include "room.hpp"
+
+#include "book.hpp"
+#include "journal.hpp"
+#include "metrics.hpp"
+#include "protocol.hpp"
+#include "server.hpp"
+#include "tablebase.hpp"
+#include <algorithm>
+#include <iostream>
+
+Room::Room(boost::asio::io_service& io, int id) :
+    room_id(id),
+    room_strand(io),
+    seats(1),
+    engine(),
+    engine_budget(0),
+    engine_thinking(false)
+{
+    metrics::add(metrics::ROOMS_OPENED);
+}
+
+Room::~Room()
+{
+    metrics::add(metrics::ROOMS_CLOSED);
+}
+
+// Engine rooms come and go with connections, so their tables are small.
+static const size_t engine_table_mb = 4;
+
+void Room::seat_engine(const EngineConfig& config,
+                       std::chrono::milliseconds budget)
+{
+    engine = config;
+    engine_budget = budget;
+    engine_table.reset(new TranspositionTable(engine_table_mb));
+    engine_random.seed(std::random_device()());
+}
+
+void Room::adjudicate_with(const Tablebases* tablebases)
+{
+    game.adjudicate_with(tablebases);
+}
+
+void Room::journal_to(Journal* journal)
+{
+    game.journal_to(journal, room_id);
+}
+
+void Room::resume(const RecoveredGame& recovered)
+{
+    seats = 0;
+    game.resume(recovered.player1, recovered.board, recovered.turn);
+}
+
+// The legal move the book suggests, if any. A hash collision with a
+// position from the book may suggest anything, so it is checked.
+static boost::optional<Move> book_choice(const OpeningBook& book, Board b,
+                                         Color side, uint32_t random)
+{
+    auto squares = book.pick(b.hash(), random);
+    if (!squares) {
+        return boost::none;
+    }
+    MoveList moves;
+    generate_legal_moves(b, side, moves);
+    for (const Move& m : moves) {
+        SimpleMove e = endpoints(m);
+        if (square_index(e.from) == square_index(squares->from) &&
+            square_index(e.to) == square_index(squares->to)) {
+            return m;
+        }
+    }
+    return boost::none;
+}
+
+int Room::id() const
+{
+    return room_id;
+}
+
+boost::asio::io_service::strand& Room::strand()
+{
+    return room_strand;
+}
+
+bool Room::claim_seat()
+{
+    int expected = 1;
+    return seats.compare_exchange_strong(expected, 2);
+}
+
+bool Room::claim_free_seat()
+{
+    int taken = seats;
+    while (taken < 2) {
+        if (seats.compare_exchange_weak(taken, taken + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int Room::join(std::shared_ptr<Session> session)
+{
+    int player = players[0] ? 2 : 1;
+    players[player - 1] = session;
+    return player;
+}
+
+Color Room::color(int player) const
+{
+    return game.color(player);
+}
+
+int Room::leave(int player)
+{
+    players[player - 1].reset();
+    game.player_left(*this, player);
+    return --seats;
+}
+
+void Room::watch(std::shared_ptr<Session> session)
+{
+    spectators.push_back(session);
+}
+
+void Room::unwatch(std::shared_ptr<Session> session)
+{
+    auto it = std::find(spectators.begin(), spectators.end(), session);
+    if (it != spectators.end()) {
+        *it = spectators.back();
+        spectators.pop_back();
+    }
+}
+
+void Room::message(int player, const Command& cmd)
+{
+    game.message_handler(*this, player, cmd);
+    engine_turn();
+}
+
+void Room::engine_turn()
+{
+    if (!engine.io || engine_thinking || !players[0]) {
+        return;
+    }
+    if (!game.is_playing() && game.is_ready(1) && !game.is_ready(2)) {
+        Command ready = Command();
+        ready.type = READY;
+        game.message_handler(*this, 2, ready);
+    }
+    if (!game.is_playing() || game.turn() != game.color(2)) {
+        return;
+    }
+
+    engine_thinking = true;
+    auto self = shared_from_this();
+    Board position = game.position();
+    Color side = game.turn();
+    SearchResult known = SearchResult();
+    if (engine.tablebases) {
+        known.best = tablebase_move(*engine.tablebases, position, side);
+    }
+    if (!known.best && engine.book) {
+        known.best = book_choice(*engine.book, position, side,
+                                 engine_random());
+    }
+    if (known.best) {
+        uint64_t key = position.hash();
+        room_strand.post([self, known, key]() {
+            self->engine_moved(known, key);
+        });
+        return;
+    }
+
+    SearchLimits limits = {engine_budget, 64, engine.threads};
+    engine.io->post([self, position, side, limits]() {
+        // only one search per room runs at a time, so the table is free
+        SearchResult result = search(position, side, limits,
+                                     *self->engine_table);
+        std::cout << "Engine in room " << self->id() << ": depth "
+                  << result.depth << ", " << result.nodes << " nodes, "
+                  << uint64_t(result.nodes / std::max(result.seconds, 1e-6))
+                  << " nodes/s.\n";
+        uint64_t key = position.hash();
+        self->room_strand.post([self, result, key]() {
+            self->engine_moved(result, key);
+        });
+    });
+}
+
+// Plays the search result unless the game moved on while it was thinking.
+void Room::engine_moved(const SearchResult& result, uint64_t position)
+{
+    engine_thinking = false;
+    if (!game.is_playing() || game.turn() != game.color(2) ||
+        game.position().hash() != position) {
+        engine_turn();
+        return;
+    }
+    // the search always has a move unless there is none, and then the game
+    // should have ended; searching again would find none either
+    if (!result.best) {
+        std::cerr << "Error: engine in room " << id() << " has no move."
+                  << std::endl;
+        return;
+    }
+
+    SimpleMove m = endpoints(*result.best);
+    Command move = Command();
+    move.type = MOVE;
+    move.args = 2;
+    move.from = m.from;
+    move.to = m.to;
+    message(2, move);
+}
+
+void Room::broadcast(const Reply& msg)
+{
+    std::shared_ptr<const std::string> encoded[2];
+    auto deliver = [&](const std::shared_ptr<Session>& session) {
+        if (!session) {
+            return;
+        }
+        auto& shared = encoded[session->binary_protocol()];
+        if (!shared) {
+            shared = std::make_shared<const std::string>(
+                session->binary_protocol() ? binary::encode(msg) :
+                                            show(msg) + '\n');
+        }
+        session->send(shared);
+    };
+
+    deliver(players[0]);
+    deliver(players[1]);
+    for (const auto& spectator : spectators) {
+        deliver(spectator);
+    }
+}
+
+void Room::send(int player, const Reply& msg)
+{
+    if (player != 1 && player != 2) {
+        return;
+    }
+    if (players[player - 1]) {
+        players[player - 1]->send(msg);
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef ROOM_HPP
+#define ROOM_HPP
+
+#include "engine.hpp"
+#include "game.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+class Journal;
+class OpeningBook;
+struct RecoveredGame;
+class Session;
+class Tablebases;
+
+// What engine rooms play with, shared by all of them.
+struct EngineConfig
+{
+    // searches run here, off the threads serving connections
+    boost::asio::io_service* io;
+    int threads;
+    const OpeningBook* book;
+    const Tablebases* tablebases;
+};
+
+// One game and the (up to two) connections playing it. Players are
+// numbered 1 and 2 as in the protocol's say1/say2.
+//
+// Everything except the seat count runs on the room's strand, so the game
+// sees its messages one at a time while other rooms run on other threads.
+// Seats are claimed by the accepting thread before the session is handed
+// over to the strand.
+//
+// Spectators receive everything that is broadcast. A broadcast is encoded
+// once per protocol and the same immutable buffer is queued on every
+// recipient.
+//
+// In an engine room seat 2 is taken by the search from engine.hpp. It
+// readies as soon as its opponent does and thinks on the engine io_service,
+// so a long search never holds up the threads serving connections. Its
+// transposition table is kept from move to move. Positions in the
+// tablebases or the opening book are answered from them without searching.
+//
+// A room resumed from the journal starts with both seats free and its game
+// under way, waiting for its players to come back.
+class Room : public std::enable_shared_from_this<Room>
+{
+public:
+    Room(boost::asio::io_service&, int id);
+    ~Room();
+
+    // Must be called before the room is shared.
+    void seat_engine(const EngineConfig&, std::chrono::milliseconds);
+    void adjudicate_with(const Tablebases*);
+    void journal_to(Journal*);
+    void resume(const RecoveredGame&);
+
+    int id() const;
+    boost::asio::io_service::strand& strand();
+
+    // claims the second seat of a room waiting for an opponent
+    bool claim_seat();
+    // claims any free seat
+    bool claim_free_seat();
+    int join(std::shared_ptr<Session>);
+    Color color(int player) const;
+    // Returns the number of players left.
+    int leave(int player);
+
+    void watch(std::shared_ptr<Session>);
+    void unwatch(std::shared_ptr<Session>);
+
+    void message(int player, const Command&);
+
+    void broadcast(const Reply&);
+    void send(int player, const Reply&);
+private:
+    int room_id;
+    boost::asio::io_service::strand room_strand;
+    std::atomic<int> seats;
+    Game game;
+    std::shared_ptr<Session> players[2];
+    std::vector<std::shared_ptr<Session>> spectators;
+
+    // engine.io is null unless seat 2 is the engine's
+    EngineConfig engine;
+    std::chrono::milliseconds engine_budget;
+    std::unique_ptr<TranspositionTable> engine_table;
+    std::minstd_rand engine_random;
+    bool engine_thinking;
+
+    void engine_turn();
+    void engine_moved(const SearchResult&, uint64_t position);
+};
+
+#endif
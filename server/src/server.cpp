@@ -1,118 +1,477 @@
 #include "server.hpp"
 
+#include "journal.hpp"
+#include "protocol.hpp"
+#include "room.hpp"
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 
 namespace asio = boost::asio;
 namespace ip = boost::asio::ip;
 namespace sys = boost::system;
 using namespace std::placeholders;
 
-Server::Server(asio::io_service& io) :
-    acceptor(io, ip::tcp::endpoint(ip::tcp::v4(), 12345)),
-    players(0)
+Session::Session(Server& s, asio::io_service& io) :
+    server(s),
+    sock(io),
+    player(0),
+    closed(false),
+    in_lobby(true),
+    binary(false),
+    flush_pending(false),
+    timed(-1),
+    timed_write(false)
 {}
 
-void Server::set_read_callback(std::function<void(Server&, int, std::string)> f)
+ip::tcp::socket& Session::socket()
 {
-    read_callback = f;
+    return sock;
 }
 
-void Server::run()
+void Session::start(std::shared_ptr<Room> r)
 {
-    accept_next();
+    room = r;
+    player = room->join(shared_from_this());
+    read_next();
 }
 
-void Server::broadcast(const std::string& msg)
+bool Session::binary_protocol() const
 {
-    send(1, msg);
-    send(2, msg);
+    return binary;
 }
 
-void Server::send(int player, const std::string& msg)
+void Session::send(const Reply& r)
 {
-    std::shared_ptr<ip::tcp::socket> s;
-    switch (player) {
-    case 1:
-        s = player1;
-        break;
-    case 2:
-        s = player2;
-        break;
-    default:
+    send(std::make_shared<const std::string>(binary ? binary::encode(r) :
+                                                      show(r) + '\n'));
+}
+
+void Session::send(Message msg)
+{
+    if (closed) {
         return;
     }
-    if (!s) {
+    queued.push_back(std::move(msg));
+    if (!flush_pending && writing.empty()) {
+        flush_pending = true;
+        room->strand().post(std::bind(&Session::flush, shared_from_this()));
+    }
+}
+
+void Session::flush()
+{
+    flush_pending = false;
+    if (handed_off() || queued.empty() || !writing.empty() || closed) {
         return;
     }
 
-    auto wh = std::bind(&Server::write_handler, this, s, _1);
-    asio::async_write(*s, asio::buffer(msg + "\n"), wh);
+    writing.swap(queued);
+    write_buffers.clear();
+    for (const Message& msg : writing) {
+        write_buffers.push_back(asio::buffer(*msg));
+    }
+    timed_write = timed >= 0;
+    auto wh = std::bind(&Session::write_handler, shared_from_this(), _1, _2);
+    asio::async_write(sock, write_buffers, room->strand().wrap(wh));
 }
 
-void Server::accept_next()
+void Session::read_next()
 {
-    auto conn = std::make_shared<ip::tcp::socket>
-                (ip::tcp::socket(acceptor.get_io_service()));
-    auto handler = std::bind(&Server::accept_handler, this, conn, _1);
-    acceptor.async_accept(*conn, handler);
+    if (binary) {
+        auto fh = std::bind(&Session::frame_handler, shared_from_this(), _1);
+        asio::async_read(sock, buf, asio::transfer_at_least(1),
+                         room->strand().wrap(fh));
+        return;
+    }
+    auto rh = std::bind(&Session::read_handler, shared_from_this(), _1, _2);
+    asio::async_read_until(sock, buf, '\n', room->strand().wrap(rh));
 }
 
-void Server::accept_handler(std::shared_ptr<ip::tcp::socket> conn,
-                            const sys::error_code& error)
+void Session::read_handler(const sys::error_code& error, size_t size)
 {
     if (error) {
-        std::cerr << "Error: " << error << std::endl;
+        if (error != asio::error::eof) {
+            std::cerr << "Error: " << error << std::endl;
+        }
+        close();
         return;
     }
 
-    auto wh = std::bind(&Server::write_handler, this, conn, _1);
-    if (players < 2) {
-        if (players == 0) {
-            player1 = conn;
-            auto rh = std::bind(&Server::read_handler, this, conn, 1, _1);
-            asio::async_read_until(*player1, buf1, '\n', rh);
-        } else {
-            player2 = conn;
-            auto rh = std::bind(&Server::read_handler, this, conn, 2, _1);
-            asio::async_read_until(*player2, buf2, '\n', rh);
+    metrics::add(metrics::BYTES_IN, size);
+    const char* data = asio::buffer_cast<const char*>(buf.data());
+    boost::string_view line(data, size - 1);
+    Tokenizer words(line);
+    boost::string_view word;
+    if (words.next(word) && word == "stats" && !words.next(word)) {
+        buf.consume(size);
+        send(std::make_shared<const std::string>(metrics::report()));
+        read_next();
+        return;
+    }
+    if (in_lobby) {
+        // a lobby command may hand the session to another room's strand,
+        // so its line is copied and consumed first
+        std::string lobby_line = line.to_string();
+        buf.consume(size);
+        if (lobby_command(lobby_line)) {
+            // otherwise the session was handed to another room, which
+            // reads from now on
+            if (binary) {
+                frame_handler(sys::error_code());
+            }
+            return;
         }
-        std::cout << "New connection.\n";
-        ++players;
+        in_lobby = false;
+        game_line(lobby_line);
     } else {
-        asio::async_write(
-                *conn,
-                asio::buffer("error full"),
-                wh);
+        // the line is parsed in place and only then consumed
+        game_line(line);
+        buf.consume(size);
     }
-    accept_next();
+
+    read_next();
 }
 
-void Server::read_handler(std::shared_ptr<ip::tcp::socket> conn,
-                          int player,
-                          const sys::error_code& error)
+void Session::game_line(boost::string_view line)
+{
+    if (player) {
+        command(read_command(line));
+    } else {
+        send(std::make_shared<const std::string>("error command\n"));
+    }
+}
+
+static_assert(metrics::READY_LATENCY == int(READY) &&
+              metrics::SAY_LATENCY == int(SAY) &&
+              metrics::MOVE_LATENCY == int(MOVE) &&
+              metrics::RESIGN_LATENCY == int(RESIGN),
+              "command latencies are indexed by command type");
+
+void Session::command(const Command& cmd)
+{
+    if (timed < 0 && cmd.type != UNKNOWN) {
+        timed = cmd.type;
+        command_at = metrics::Clock::now();
+    }
+    room->message(player, cmd);
+}
+
+// Handles the commands that are about the connection rather than the game:
+// "binary", "watch <room>", "resume <room>" and "engine [ms]".
+bool Session::lobby_command(boost::string_view line)
+{
+    Tokenizer words(line);
+    boost::string_view word;
+    if (!words.next(word)) {
+        return false;
+    }
+
+    if (word == "binary") {
+        send(std::make_shared<const std::string>("binary\n"));
+        flush();
+        binary = true;
+        in_lobby = false;
+        return true;
+    }
+
+    bool engine = word == "engine";
+    bool resuming = word == "resume";
+    if ((word != "watch" && !engine && !resuming) || !player) {
+        return false;
+    }
+    int number = 0;
+    if (words.next(word)) {
+        for (char c : word) {
+            number = c >= '0' && c <= '9' && number < 100000000 ?
+                     number * 10 + (c - '0') : -1;
+        }
+    } else if (engine) {
+        number = 1000;
+    }
+
+    std::shared_ptr<Room> target;
+    if (engine) {
+        if (number > 0 && number <= 60000) {
+            target = server.engine_room(std::chrono::milliseconds(number));
+        }
+    } else if (number > 0) {
+        target = server.find_room(number);
+    }
+    if (!target || (resuming && !target->claim_free_seat())) {
+        return false;
+    }
+
+    if (room->leave(player) == 1) {
+        server.reopen(room);
+    }
+    player = 0;
+    move_to(target, engine ? &Session::play_engine :
+                    resuming ? &Session::resume : &Session::watch);
+    return true;
+}
+
+// The session's handlers must all run on one strand, so it only moves to
+// the target's once no write or flush is left to finish on this one. What
+// is still queued then goes out from the target's strand.
+void Session::move_to(std::shared_ptr<Room> target,
+                      void (Session::*next)(std::shared_ptr<Room>))
+{
+    auto self = shared_from_this();
+    hand_off = [self, target, next]() {
+        target->strand().post(std::bind(next, self, target));
+    };
+    handed_off();
+}
+
+bool Session::handed_off()
+{
+    if (!hand_off || flush_pending || !writing.empty()) {
+        return false;
+    }
+    auto post = std::move(hand_off);
+    hand_off = nullptr;
+    post();
+    return true;
+}
+
+void Session::watch(std::shared_ptr<Room> target)
+{
+    room = target;
+    room->watch(shared_from_this());
+    send(std::make_shared<const std::string>(
+            "watching " + std::to_string(room->id()) + '\n'));
+    read_next();
+}
+
+void Session::play_engine(std::shared_ptr<Room> target)
+{
+    start(target);
+    send(std::make_shared<const std::string>(
+            "engine " + std::to_string(room->id()) + '\n'));
+}
+
+// Tells the player which side it has, since the game will not start again.
+void Session::resume(std::shared_ptr<Room> target)
+{
+    start(target);
+    send(std::make_shared<const std::string>(
+            "resumed " + std::to_string(room->id()) + ' ' +
+            show(room->color(player)) + '\n'));
+}
+
+void Session::frame_handler(const sys::error_code& error)
 {
     if (error) {
-        std::cerr << "Error: " << error << std::endl;
+        if (error != asio::error::eof) {
+            std::cerr << "Error: " << error << std::endl;
+        }
+        close();
+        return;
+    }
+
+    while (buf.size() >= binary::header_size) {
+        const char* data = asio::buffer_cast<const char*>(buf.data());
+        size_t size = binary::payload_size(data);
+        if (size > binary::max_payload) {
+            close();
+            return;
+        }
+        if (buf.size() < binary::header_size + size) {
+            break;
+        }
+        boost::string_view payload(data + binary::header_size, size);
+        metrics::add(metrics::BYTES_IN, binary::header_size + size);
+        if (player) {
+            command(binary::read_frame(payload));
+        } else {
+            Reply error = Reply();
+            error.type = BAD_COMMAND;
+            send(error);
+        }
+        buf.consume(binary::header_size + size);
+    }
+
+    read_next();
+}
+
+void Session::write_handler(const sys::error_code& error, size_t size)
+{
+    metrics::add(metrics::BYTES_OUT, size);
+    if (timed_write) {
+        if (!error) {
+            metrics::record(metrics::Timing(timed),
+                            metrics::Clock::now() - command_at);
+        }
+        timed = -1;
+        timed_write = false;
+    }
+    writing.clear();
+    if (error) {
+        if (error != asio::error::operation_aborted) {
+            std::cerr << "Error: " << error << std::endl;
+        }
+        queued.clear();
+        handed_off();
+        return;
+    }
+    flush();
+}
+
+void Session::close()
+{
+    if (closed) {
         return;
     }
+    closed = true;
+    metrics::add(metrics::CONNECTIONS_CLOSED);
+    sys::error_code ignored;
+    sock.close(ignored);
+    if (!player) {
+        room->unwatch(shared_from_this());
+    } else if (room->leave(player) == 1) {
+        server.reopen(room);
+    }
+}
 
-    asio::streambuf* buf = player == 1 ? &buf1 : &buf2;
+Server::Server(asio::io_service& io, const EngineConfig& engine,
+               const Tablebases* adjudicator) :
+    io(io),
+    engine(engine),
+    adjudicator(adjudicator),
+    journal(nullptr),
+    acceptor(io, ip::tcp::endpoint(ip::tcp::v4(), 12345)),
+    sweep_at(64),
+    next_room_id(1)
+{}
 
-    std::string msg((std::istreambuf_iterator<char>(buf)),
-                    std::istreambuf_iterator<char>());
+void Server::journal_to(Journal* j)
+{
+    journal = j;
+}
 
-    if (read_callback) {
-        read_callback(*this, player, msg);
+// Nothing but the server holds a resumed room until its players are back,
+// and they may never be, so the server holds them for good.
+void Server::resume(const std::vector<RecoveredGame>& games)
+{
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    for (const RecoveredGame& game : games) {
+        auto room = std::make_shared<Room>(io, game.room);
+        room->adjudicate_with(adjudicator);
+        room->journal_to(journal);
+        room->resume(game);
+        resumed.push_back(room);
+        add_room(room);
+        next_room_id = std::max(next_room_id, game.room + 1);
     }
+}
+
+void Server::run()
+{
+    accept_next();
+}
 
-    auto rh = std::bind(&Server::read_handler, this, conn, player, _1);
-    asio::async_read_until(*conn, *buf, '\n', rh);
+void Server::serve_stats(unsigned short port)
+{
+    stats_acceptor.reset(new ip::tcp::acceptor(
+        io, ip::tcp::endpoint(ip::address_v4::loopback(), port)));
+    accept_stats();
 }
 
-void Server::write_handler(std::shared_ptr<ip::tcp::socket>,
-                           const sys::error_code& error)
+static void write_stats(std::shared_ptr<ip::tcp::socket> sock)
+{
+    auto text = std::make_shared<const std::string>(metrics::report());
+    asio::async_write(*sock, asio::buffer(*text),
+                      [sock, text](const sys::error_code&, size_t) {
+                          sys::error_code ignored;
+                          sock->shutdown(ip::tcp::socket::shutdown_both,
+                                         ignored);
+                      });
+}
+
+void Server::accept_stats()
+{
+    auto sock = std::make_shared<ip::tcp::socket>(io);
+    auto handler = [this, sock](const sys::error_code& error) {
+        if (!error) {
+            write_stats(sock);
+        }
+        accept_stats();
+    };
+    stats_acceptor->async_accept(*sock, handler);
+}
+
+void Server::reopen(std::shared_ptr<Room> room)
+{
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    open_rooms.push_back(room);
+}
+
+std::shared_ptr<Room> Server::find_room(int id)
+{
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    auto it = rooms.find(id);
+    return it == rooms.end() ? nullptr : it->second.lock();
+}
+
+std::shared_ptr<Room> Server::open_room()
+{
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    while (!open_rooms.empty()) {
+        auto room = open_rooms.front().lock();
+        open_rooms.pop_front();
+        if (room && room->claim_seat()) {
+            return room;
+        }
+    }
+    auto room = std::make_shared<Room>(io, next_room_id++);
+    room->adjudicate_with(adjudicator);
+    room->journal_to(journal);
+    open_rooms.push_back(room);
+    add_room(room);
+    return room;
+}
+
+// Engine rooms are never offered to other connections.
+std::shared_ptr<Room> Server::engine_room(std::chrono::milliseconds budget)
+{
+    std::lock_guard<std::mutex> lock(rooms_mutex);
+    auto room = std::make_shared<Room>(io, next_room_id++);
+    room->seat_engine(engine, budget);
+    room->adjudicate_with(adjudicator);
+    add_room(room);
+    return room;
+}
+
+// Expects rooms_mutex to be held.
+void Server::add_room(std::shared_ptr<Room> room)
+{
+    if (rooms.size() >= sweep_at) {
+        for (auto it = rooms.begin(); it != rooms.end(); ) {
+            it = it->second.expired() ? rooms.erase(it) : std::next(it);
+        }
+        sweep_at = std::max(size_t(64), 2 * rooms.size());
+    }
+    rooms[room->id()] = room;
+}
+
+void Server::accept_next()
+{
+    auto session = std::make_shared<Session>(*this, io);
+    auto handler = std::bind(&Server::accept_handler, this, session, _1);
+    acceptor.async_accept(session->socket(), handler);
+}
+
+void Server::accept_handler(std::shared_ptr<Session> session,
+                            const sys::error_code& error)
 {
     if (error) {
         std::cerr << "Error: " << error << std::endl;
+    } else {
+        metrics::add(metrics::CONNECTIONS_OPENED);
+        auto room = open_room();
+        room->strand().dispatch(std::bind(&Session::start, session, room));
+        std::cout << "New connection in room " << room->id() << ".\n";
     }
+    accept_next();
 }
@@ -1,34 +1,139 @@
 #ifndef SERVER_HPP
 #define SERVER_HPP
 
+#include "metrics.hpp"
+#include "room.hpp"
+
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <boost/asio.hpp>
+#include <boost/utility/string_view.hpp>
+
+class Server;
+struct Reply;
+
+// One connection. All of its handlers run on its room's strand.
+//
+// Outgoing messages are queued and written with one gathering write at a
+// time; everything sent while a write is in flight, or within the same
+// handler, goes out together in the next one.
+//
+// Before its first game command a session may send "watch <room>" to give
+// up its seat and follow that room as a spectator, "resume <room>" to take a
+// free seat there, as after a restart, or "engine [ms]" to move to a room of
+// its own against the engine, thinking that many milliseconds per move.
+// Then "binary" switches both directions to the frames from protocol.hpp.
+// A text session may send "stats" at any time for the server's metrics.
+//
+// One command at a time is timed, from being handled to the end of the
+// next write to the session, which carries its reply.
+class Session : public std::enable_shared_from_this<Session>
+{
+public:
+    // fully encoded, including the text protocol's newline
+    typedef std::shared_ptr<const std::string> Message;
+
+    Session(Server&, boost::asio::io_service&);
+
+    boost::asio::ip::tcp::socket& socket();
+    void start(std::shared_ptr<Room>);
+    bool binary_protocol() const;
+    void send(const Reply&);
+    void send(Message);
+private:
+
+    Server& server;
+    boost::asio::ip::tcp::socket sock;
+    boost::asio::streambuf buf;
+    std::shared_ptr<Room> room;
+    // 0 for a spectator
+    int player;
+    bool closed;
+    bool in_lobby;
+    bool binary;
 
+    std::vector<Message> queued, writing;
+    std::vector<boost::asio::const_buffer> write_buffers;
+    bool flush_pending;
+    // posts the session to the room it is moving to, once nothing of it
+    // is left to run on the current room's strand
+    std::function<void()> hand_off;
+
+    // -1 when no command is being timed
+    int timed;
+    bool timed_write;
+    metrics::Clock::time_point command_at;
+
+    bool lobby_command(boost::string_view);
+    void game_line(boost::string_view);
+    void command(const Command&);
+    void move_to(std::shared_ptr<Room>,
+                 void (Session::*)(std::shared_ptr<Room>));
+    bool handed_off();
+    void watch(std::shared_ptr<Room>);
+    void play_engine(std::shared_ptr<Room>);
+    void resume(std::shared_ptr<Room>);
+    void read_next();
+    void read_handler(const boost::system::error_code&, size_t);
+    void frame_handler(const boost::system::error_code&);
+    void flush();
+    void write_handler(const boost::system::error_code&, size_t);
+    void close();
+};
+
+// Accepts connections and pairs them into rooms, each running its own
+// game. A room that loses a player is offered to the next connection.
+// Safe to run the io_service on several threads. Games are adjudicated
+// with the given tablebases, if any.
+//
+// Games between connections are written to the journal, if there is one;
+// engine games are not, as the engine's side could not be resumed.
+//
+// The metrics can also be read from a port of their own on the loopback
+// interface, which writes them to every connection and closes it.
 class Server
 {
 public:
-    Server(boost::asio::io_service&);
+    Server(boost::asio::io_service&, const EngineConfig&,
+           const Tablebases* adjudicator);
 
-    void set_read_callback(std::function<void(Server&, int, std::string)>);
-    void run();
+    // Both must be called before run().
+    void journal_to(Journal*);
+    void resume(const std::vector<RecoveredGame>&);
 
-    void broadcast(const std::string&);
-    void send(int player, const std::string&);
+    void run();
+    void serve_stats(unsigned short port);
+    void reopen(std::shared_ptr<Room>);
+    std::shared_ptr<Room> find_room(int id);
+    std::shared_ptr<Room> engine_room(std::chrono::milliseconds);
 private:
+    boost::asio::io_service& io;
+    EngineConfig engine;
+    const Tablebases* adjudicator;
+    Journal* journal;
     boost::asio::ip::tcp::acceptor acceptor;
-    std::function<void(Server&, int, std::string)> read_callback;
-    int players;
-    std::shared_ptr<boost::asio::ip::tcp::socket> player1, player2;
-    boost::asio::streambuf buf1, buf2;
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> stats_acceptor;
+
+    std::mutex rooms_mutex;
+    std::deque<std::weak_ptr<Room>> open_rooms;
+    std::unordered_map<int, std::weak_ptr<Room>> rooms;
+    std::vector<std::shared_ptr<Room>> resumed;
+    size_t sweep_at;
+    int next_room_id;
+
+    std::shared_ptr<Room> open_room();
+    void add_room(std::shared_ptr<Room>);
 
     void accept_next();
-    void accept_handler(std::shared_ptr<boost::asio::ip::tcp::socket>,
+    void accept_handler(std::shared_ptr<Session>,
                         const boost::system::error_code&);
-    void read_handler(std::shared_ptr<boost::asio::ip::tcp::socket>,
-                      int,
-                      const boost::system::error_code&);
-    void write_handler(std::shared_ptr<boost::asio::ip::tcp::socket>,
-                       const boost::system::error_code&);
+    void accept_stats();
 };
 
 #endif
@@ -0,0 +1,236 @@
+#include "sliders.hpp"
+
+#include <atomic>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_PEXT 1
+#endif
+
+static const Square rook_dirs[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+static const Square bishop_dirs[4] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+// The slow way, to fill the tables: walking each ray to the first piece.
+static Bitboard walk_attacks(int square, Bitboard occupied,
+                             const Square (&dirs)[4])
+{
+    Square s = index_square(square);
+    Bitboard attacks = 0;
+    for (Square d : dirs) {
+        Square to = {s.row + d.row, s.col + d.col};
+        for (; on_board(to); to.row += d.row, to.col += d.col) {
+            attacks |= square_bit(to);
+            if (occupied & square_bit(to)) {
+                break;
+            }
+        }
+    }
+    return attacks;
+}
+
+// The squares whose pieces can block a slider on the square: its rays
+// without their last square, as a piece on the edge blocks nothing.
+static Bitboard blocker_mask(int square, const Square (&dirs)[4])
+{
+    Square s = index_square(square);
+    Bitboard mask = 0;
+    for (Square d : dirs) {
+        Square to = {s.row + d.row, s.col + d.col};
+        for (; on_board({to.row + d.row, to.col + d.col});
+             to.row += d.row, to.col += d.col) {
+            mask |= square_bit(to);
+        }
+    }
+    return mask;
+}
+
+// Per square: where its attacks start in the tables, and how to index
+// them. Each square has 2^popcount(mask) entries in both tables, ordered
+// by magic index in one and by PEXT index in the other.
+struct SlidingSquare
+{
+    Bitboard mask;
+    Bitboard magic;
+    unsigned shift;
+    const Bitboard* by_magic;
+    const Bitboard* by_pext;
+
+    size_t magic_index(Bitboard occupied) const
+    {
+        return size_t(((occupied & mask) * magic) >> shift);
+    }
+};
+
+// Found by trying sparse random numbers from a fixed seed until one mapped
+// every occupancy of the square to an entry that was free or already held
+// the same attacks.
+static const Bitboard rook_magics[64] = {
+    0x1080004008801020ULL, 0x0840092002c03000ULL, 0x1900200010400900ULL,
+    0x0880100008000480ULL, 0x4200100420080200ULL, 0x8100020100080400ULL,
+    0x0200040110886200ULL, 0x0200008040220411ULL, 0x0404800084400220ULL,
+    0x0000401000402000ULL, 0x0086001081220440ULL, 0x0408800800100280ULL,
+    0x000a001201040820ULL, 0x8848800200840080ULL, 0x4001000100040200ULL,
+    0x0442000102105084ULL, 0x9080010020804100ULL, 0x0040404000201009ULL,
+    0x0000808010002009ULL, 0x2200090021d00100ULL, 0x0008008008040080ULL,
+    0x0004004002010040ULL, 0x0011040008015042ULL, 0x00000a0001768104ULL,
+    0x0000800080204009ULL, 0x2010004140002001ULL, 0x9800200280100080ULL,
+    0x1000100080080080ULL, 0x0442000a00049020ULL, 0x2100040080020080ULL,
+    0x0800120400900148ULL, 0x0010040a00128541ULL, 0x2800804000800030ULL,
+    0x1010002000400041ULL, 0x4000200011004100ULL, 0x0610008410800800ULL,
+    0x0400802402800800ULL, 0xc100020080800400ULL, 0x0002000802000401ULL,
+    0x0182085882000401ULL, 0x0220204000808000ULL, 0x2860100040024022ULL,
+    0x0001002004110040ULL, 0x99101042000a0020ULL, 0x0004080004008080ULL,
+    0x0010040002008080ULL, 0x2012004881020004ULL, 0x8300842444820011ULL,
+    0x0088403882010200ULL, 0x0820400080210100ULL, 0x0110910040a00300ULL,
+    0x0801100280080480ULL, 0x0242009008200600ULL, 0x1002000489500200ULL,
+    0x0040800200010080ULL, 0x0091800041000080ULL, 0x0000209300488001ULL,
+    0x04c1002414824001ULL, 0x020020000b001041ULL, 0x7000100004200901ULL,
+    0x8002002004100802ULL, 0x30010002084c0007ULL, 0x0888221800813004ULL,
+    0x4000002840840112ULL
+};
+
+static const Bitboard bishop_magics[64] = {
+    0x10102002004a1420ULL, 0x8020040400584008ULL, 0x10510800811201c8ULL,
+    0x5204042080000088ULL, 0x2204106880000002ULL, 0x1401042004000000ULL,
+    0x0400880410042004ULL, 0x0028208200a02020ULL, 0x1500241990010e00ULL,
+    0x8001200182020a40ULL, 0x40004101030b0000ULL, 0x8002041042000100ULL,
+    0x4010011041020038ULL, 0x0000010421044000ULL, 0x1500210808020a00ULL,
+    0x8000088400880520ULL, 0x0405004010040100ULL, 0x1005823210040108ULL,
+    0x2708008102040011ULL, 0x4048200404009100ULL, 0x0018104101400024ULL,
+    0x0003000601190101ULL, 0x8004803108491000ULL, 0x8014241200820800ULL,
+    0x0006e080100c3040ULL, 0x0501044a11041800ULL, 0x9020300008004045ULL,
+    0x0894080000220040ULL, 0x1001010083104000ULL, 0x5004030040900080ULL,
+    0x000400422c012400ULL, 0x0002128698404812ULL, 0x1010108404900440ULL,
+    0x0928021182084100ULL, 0x2006080409020024ULL, 0x1010202020180080ULL,
+    0xa010008200202200ULL, 0x2098015100019004ULL, 0x0002041440810811ULL,
+    0x802a02020000b098ULL, 0x0009015090004060ULL, 0x4000821082081001ULL,
+    0x0100210040420800ULL, 0x0800004010488a00ULL, 0x2000081104004040ULL,
+    0x4c8e029015000082ULL, 0x0420340322224842ULL, 0x1298260043400210ULL,
+    0x0000822802400008ULL, 0x00008a0101600000ULL, 0x3040003412080021ULL,
+    0x3040290220884800ULL, 0x4a1500401041004aULL, 0x8010200282020781ULL,
+    0x0020203142209091ULL, 0x0070300600902110ULL, 0x0040808800b62048ULL,
+    0x0000810400c44420ULL, 0x00080400440c0441ULL, 0x8340080020840411ULL,
+    0x0000000104208200ULL, 0x0000800810d00080ULL, 0x0400530411080200ULL,
+    0x4040702400932244ULL
+};
+
+class SlidingTables
+{
+public:
+    SlidingTables(const Square (&dirs)[4], const Bitboard (&magics)[64],
+                  size_t size) :
+        magic_table(size), pext_table(size)
+    {
+        size_t offset = 0;
+        for (int s = 0; s < 64; ++s) {
+            SlidingSquare& sq = squares[s];
+            sq.mask = blocker_mask(s, dirs);
+            int bits = __builtin_popcountll(sq.mask);
+            sq.magic = magics[s];
+            sq.shift = unsigned(64 - bits);
+            sq.by_magic = &magic_table[offset];
+            sq.by_pext = &pext_table[offset];
+
+            // every subset of the mask, in PEXT order
+            Bitboard occupied = 0;
+            size_t i = 0;
+            do {
+                Bitboard attacks = walk_attacks(s, occupied, dirs);
+                pext_table[offset + i++] = attacks;
+                magic_table[offset + sq.magic_index(occupied)] = attacks;
+                occupied = (occupied - sq.mask) & sq.mask;
+            } while (occupied);
+            offset += i;
+        }
+    }
+
+    const SlidingSquare& operator[](int square) const
+    {
+        return squares[square];
+    }
+private:
+    SlidingSquare squares[64];
+    std::vector<Bitboard> magic_table, pext_table;
+};
+
+bool pext_supported()
+{
+#ifdef HAVE_PEXT
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2");
+#else
+    return false;
+#endif
+}
+
+struct Sliders
+{
+    // 4096 occupancies for a rook in a corner, down to 1024 in the middle,
+    // and up to 512 for a bishop.
+    SlidingTables rook{rook_dirs, rook_magics, 102400};
+    SlidingTables bishop{bishop_dirs, bishop_magics, 5248};
+    bool use_pext = pext_supported();
+};
+
+// Built on first use rather than before main, where the rules in other
+// translation units may already need them. The pointer is set once they
+// are, so the lookups only pay for loading it.
+static std::atomic<Sliders*> built(nullptr);
+
+__attribute__((noinline, cold))
+static Sliders& build_sliders()
+{
+    static Sliders s;
+    built.store(&s, std::memory_order_release);
+    return s;
+}
+
+static inline Sliders& sliders()
+{
+    Sliders* s = built.load(std::memory_order_acquire);
+    return s ? *s : build_sliders();
+}
+
+SlidingLookup sliding_lookup()
+{
+    return sliders().use_pext ? PEXT_LOOKUP : MAGIC_LOOKUP;
+}
+
+bool use_sliding_lookup(SlidingLookup lookup)
+{
+    if (lookup == PEXT_LOOKUP && !pext_supported()) {
+        return false;
+    }
+    sliders().use_pext = lookup == PEXT_LOOKUP;
+    return true;
+}
+
+#ifdef HAVE_PEXT
+__attribute__((target("bmi2")))
+static Bitboard pext_attacks(const SlidingSquare& sq, Bitboard occupied)
+{
+    return sq.by_pext[_pext_u64(occupied, sq.mask)];
+}
+#else
+static Bitboard pext_attacks(const SlidingSquare& sq, Bitboard occupied)
+{
+    return sq.by_magic[sq.magic_index(occupied)];
+}
+#endif
+
+Bitboard rook_attacks(int square, Bitboard occupied)
+{
+    const Sliders& s = sliders();
+    const SlidingSquare& sq = s.rook[square];
+    return s.use_pext ? pext_attacks(sq, occupied) :
+                        sq.by_magic[sq.magic_index(occupied)];
+}
+
+Bitboard bishop_attacks(int square, Bitboard occupied)
+{
+    const Sliders& s = sliders();
+    const SlidingSquare& sq = s.bishop[square];
+    return s.use_pext ? pext_attacks(sq, occupied) :
+                        sq.by_magic[sq.magic_index(occupied)];
+}
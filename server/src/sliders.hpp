@@ -0,0 +1,27 @@
+#ifndef SLIDERS_HPP
+#define SLIDERS_HPP
+
+#include "chess.hpp"
+
+// Rook and bishop attacks for any occupancy in one table lookup, however
+// long the rays. The table is indexed by the occupancy of the squares that
+// can block, either multiplied by a magic number or gathered with the BMI2
+// PEXT instruction. Both are built on first use and PEXT is used wherever
+// the CPU has it.
+enum SlidingLookup
+{
+    MAGIC_LOOKUP, PEXT_LOOKUP
+};
+
+bool pext_supported();
+SlidingLookup sliding_lookup();
+// For benchmarks and tests. Returns false, changing nothing, for
+// PEXT_LOOKUP on a CPU without it.
+bool use_sliding_lookup(SlidingLookup);
+
+// The squares a rook or bishop on the square (a square_index) reaches, up
+// to and including the first piece in each direction.
+Bitboard rook_attacks(int square, Bitboard occupied);
+Bitboard bishop_attacks(int square, Bitboard occupied);
+
+#endif
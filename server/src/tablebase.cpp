@@ -0,0 +1,516 @@
+#include "tablebase.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+
+struct TableHeader
+{
+    char magic[8];
+    uint32_t endgame;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+static const char table_magic[8] = {'P', 'S', 'Z', 'T', 'B', '0', '0', '1'};
+
+// the strong side's pieces besides its king
+static const Piece extra_pieces[ENDGAMES][2] =
+    {{QUEEN}, {ROOK}, {PAWN}, {BISHOP, KNIGHT}};
+static const int extra_count[ENDGAMES] = {1, 1, 1, 2};
+
+// A position in table coordinates: strong king, bare king, then the extra
+// pieces, with the strong side white.
+struct Placement
+{
+    int squares[4];
+    Color to_move;
+};
+
+std::string endgame_name(Endgame e)
+{
+    static const char* names[ENDGAMES] = {"KQK", "KRK", "KPK", "KBNK"};
+    return names[e];
+}
+
+static int piece_count(Endgame e)
+{
+    return 2 + extra_count[e];
+}
+
+size_t table_size(Endgame e)
+{
+    return size_t(2) << (6 * piece_count(e));
+}
+
+static size_t table_index(Endgame e, const Placement& p)
+{
+    size_t index = p.to_move;
+    for (int i = 0; i < piece_count(e); ++i) {
+        index = index << 6 | p.squares[i];
+    }
+    return index;
+}
+
+static Placement placement(Endgame e, size_t index)
+{
+    Placement p;
+    for (int i = piece_count(e) - 1; i >= 0; --i) {
+        p.squares[i] = index & 63;
+        index >>= 6;
+    }
+    p.to_move = Color(index);
+    return p;
+}
+
+static bool single(Bitboard b)
+{
+    return b && !(b & (b - 1));
+}
+
+static boost::optional<Color> strong_side(const Board& b)
+{
+    for (Color strong : {WHITE, BLACK}) {
+        Color weak = strong == WHITE ? BLACK : WHITE;
+        if (b.pieces(weak) == b.pieces(weak, KING) &&
+            single(b.pieces(weak)) && single(b.pieces(strong, KING))) {
+            return strong;
+        }
+    }
+    return boost::none;
+}
+
+boost::optional<Endgame> classify(const Board& b)
+{
+    auto strong = strong_side(b);
+    if (!strong) {
+        return boost::none;
+    }
+    Bitboard unmoved = b.unmoved_pieces();
+    if ((unmoved & b.pieces(*strong, KING)) &&
+        (unmoved & b.pieces(*strong, ROOK))) {
+        return boost::none;
+    }
+
+    Bitboard extras = b.pieces(*strong) & ~b.pieces(*strong, KING);
+    for (int e = 0; e < ENDGAMES; ++e) {
+        Bitboard expected = 0;
+        bool matches = true;
+        for (int i = 0; i < extra_count[e]; ++i) {
+            Bitboard of_kind = b.pieces(*strong, extra_pieces[e][i]);
+            matches = matches && single(of_kind);
+            expected |= of_kind;
+        }
+        if (matches && expected == extras &&
+            __builtin_popcountll(extras) == extra_count[e]) {
+            return Endgame(e);
+        }
+    }
+    return boost::none;
+}
+
+// Board coordinates flipped top to bottom when the strong side is black,
+// so a black pawn walks up the table like a white one.
+static Placement placement(Endgame e, const Board& b, Color to_move)
+{
+    Color strong = *strong_side(b);
+    Color weak = strong == WHITE ? BLACK : WHITE;
+    int flip = strong == WHITE ? 0 : 56;
+
+    Placement p;
+    p.squares[0] = __builtin_ctzll(b.pieces(strong, KING)) ^ flip;
+    p.squares[1] = __builtin_ctzll(b.pieces(weak, KING)) ^ flip;
+    for (int i = 0; i < extra_count[e]; ++i) {
+        p.squares[2 + i] =
+            __builtin_ctzll(b.pieces(strong, extra_pieces[e][i])) ^ flip;
+    }
+    p.to_move = to_move == strong ? WHITE : BLACK;
+    return p;
+}
+
+// Pawns on their first row have not moved and may still step twice.
+static Board board(Endgame e, const Placement& p)
+{
+    Board b;
+    b.put({WHITE, KING}, index_square(p.squares[0]));
+    b.put({BLACK, KING}, index_square(p.squares[1]));
+    for (int i = 0; i < extra_count[e]; ++i) {
+        b.put({WHITE, extra_pieces[e][i]}, index_square(p.squares[2 + i]));
+    }
+    b.set_unmoved(b.pieces(WHITE, PAWN) & 0x00ff000000000000ULL);
+    return b;
+}
+
+static const Square king_steps[8] =
+    {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+static const Square knight_jumps[8] =
+    {{2, 1}, {-2, 1}, {2, -1}, {-2, -1}, {1, 2}, {-1, 2}, {1, -2}, {-1, -2}};
+static const Square rook_dirs[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+static const Square bishop_dirs[4] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+
+// Retrograde analysis. Every legal position first gets its legal moves
+// counted, and mates, stalemates and moves leaving the table (captures of
+// the bare king, promotions) are scored. Then results spread backwards
+// one ply at a time by un-making moves: the predecessors of a lost
+// position are won, and a position whose moves all reach won positions is
+// lost. Going in order of plies makes the first result found the fastest
+// mate or the longest defence.
+class Generator
+{
+public:
+    Generator(Endgame e, const Tablebases& known) :
+        endgame(e),
+        known(known),
+        value(table_size(e), unknown),
+        moves_left(table_size(e)),
+        buckets(max_plies + 2)
+    {
+        if (e == KPK) {
+            escape_plies.resize(table_size(e));
+        }
+    }
+
+    std::vector<int8_t> run()
+    {
+        for (size_t i = 0; i < value.size(); ++i) {
+            score_moves(i);
+        }
+        for (int plies = 0; plies <= max_plies; ++plies) {
+            for (uint32_t entry : buckets[plies]) {
+                size_t i = entry & ~tentative;
+                if (entry & tentative) {
+                    if (value[i] != unknown) {
+                        continue;
+                    }
+                    value[i] = int8_t(plies);
+                }
+                spread(i, plies);
+            }
+            buckets[plies].clear();
+        }
+        for (int8_t& v : value) {
+            if (v == unknown || v == illegal) {
+                v = 0;
+            }
+        }
+        return std::move(value);
+    }
+private:
+    static const int8_t unknown = -128;
+    static const int8_t illegal = 127;
+    static const int max_plies = 125;
+    static const uint32_t tentative = 1u << 31;
+    // moves_left bit for a move leaving the table that does not lose
+    static const uint8_t has_escape = 0x80;
+
+    Endgame endgame;
+    const Tablebases& known;
+    std::vector<int8_t> value;
+    std::vector<uint8_t> moves_left;
+    // longest mate the opponent has after a move leaving the table
+    std::vector<uint8_t> escape_plies;
+    std::vector<std::vector<uint32_t>> buckets;
+
+    void push(size_t i, int plies, uint32_t flags = 0)
+    {
+        if (plies > max_plies) {
+            throw std::logic_error("mate too long for " +
+                                   endgame_name(endgame));
+        }
+        buckets[plies].push_back(uint32_t(i) | flags);
+    }
+
+    bool valid(const Placement& p) const
+    {
+        Bitboard seen = 0;
+        for (int i = 0; i < piece_count(endgame); ++i) {
+            Bitboard bit = Bitboard(1) << p.squares[i];
+            if (seen & bit) {
+                return false;
+            }
+            seen |= bit;
+        }
+        int pawn_row = p.squares[2] >> 3;
+        return endgame != KPK || (pawn_row != 0 && pawn_row != 7);
+    }
+
+    void score_moves(size_t i)
+    {
+        Placement p = placement(endgame, i);
+        if (!valid(p)) {
+            value[i] = illegal;
+            return;
+        }
+        Board b = board(endgame, p);
+        Color c = p.to_move;
+        Color opp = c == WHITE ? BLACK : WHITE;
+        if (in_check(b, opp)) {
+            value[i] = illegal;
+            return;
+        }
+
+        MoveList moves;
+        generate_legal_moves(b, c, moves);
+        if (moves.empty()) {
+            if (in_check(b, c)) {
+                value[i] = -1;
+                push(i, 0);
+            } else {
+                value[i] = 0;
+            }
+            return;
+        }
+
+        int in_table = 0;
+        bool escape = false;
+        int fastest_win = max_plies + 1;
+        int longest_loss = 0;
+        for (const Move& m : moves) {
+            bool promotes = m.movement.which() == 2;
+            if (!m.hit && !promotes) {
+                ++in_table;
+                continue;
+            }
+            // the bare king took the last piece, a draw, or a pawn became
+            // a queen
+            int v = 0;
+            if (promotes && !m.hit) {
+                Undo u = apply(b, m);
+                v = known.probe(b, opp).value_or(0);
+                undo(b, m, u);
+            }
+            if (v == 0) {
+                escape = true;
+            } else if (v < 0) {
+                fastest_win = std::min(fastest_win, -v);
+            } else {
+                longest_loss = std::max(longest_loss, v + 1);
+            }
+        }
+
+        if (fastest_win <= max_plies) {
+            push(i, fastest_win, tentative);
+        }
+        if (in_table == 0 && fastest_win > max_plies) {
+            if (escape) {
+                value[i] = 0;
+            } else {
+                value[i] = int8_t(-longest_loss - 1);
+                push(i, longest_loss);
+            }
+            return;
+        }
+        // a win waiting in its bucket also keeps the position from losing
+        escape = escape || fastest_win <= max_plies;
+        moves_left[i] = uint8_t(in_table | (escape ? has_escape : 0));
+        if (!escape_plies.empty()) {
+            escape_plies[i] = uint8_t(longest_loss);
+        }
+    }
+
+    // Position i was decided in the given number of plies; tell the
+    // positions one move before it.
+    void spread(size_t i, int plies)
+    {
+        Placement p = placement(endgame, i);
+        bool lost = value[i] < 0;
+        Color mover = p.to_move == WHITE ? BLACK : WHITE;
+        Bitboard occupied = 0;
+        for (int k = 0; k < piece_count(endgame); ++k) {
+            occupied |= Bitboard(1) << p.squares[k];
+        }
+
+        Placement before = p;
+        before.to_move = mover;
+        auto visit = [&](int k, int from) {
+            before.squares[k] = from;
+            size_t j = table_index(endgame, before);
+            before.squares[k] = p.squares[k];
+            if (value[j] != unknown) {
+                return;
+            }
+            if (lost) {
+                value[j] = int8_t(plies + 1);
+                push(j, plies + 1);
+            } else if (--moves_left[j] == 0) {
+                int loss = std::max(plies, escape_plies.empty() ? 0 :
+                                           int(escape_plies[j])) + 1;
+                value[j] = int8_t(-loss - 1);
+                push(j, loss);
+            }
+        };
+
+        if (mover == BLACK) {
+            origins(1, KING, p, occupied, visit);
+            return;
+        }
+        origins(0, KING, p, occupied, visit);
+        for (int k = 0; k < extra_count[endgame]; ++k) {
+            origins(2 + k, extra_pieces[endgame][k], p, occupied, visit);
+        }
+    }
+
+    // Squares the piece k could have come from without capturing.
+    template <typename Visit>
+    static void origins(int k, Piece piece, const Placement& p,
+                        Bitboard occupied, Visit& visit)
+    {
+        Square to = index_square(p.squares[k]);
+        auto empty = [&](Square s) {
+            return on_board(s) && !(occupied & square_bit(s));
+        };
+        auto steps = [&](const Square (&diffs)[8]) {
+            for (const Square& d : diffs) {
+                Square from = {to.row + d.row, to.col + d.col};
+                if (empty(from)) {
+                    visit(k, square_index(from));
+                }
+            }
+        };
+        auto rays = [&](const Square (&dirs)[4]) {
+            for (const Square& d : dirs) {
+                Square from = {to.row + d.row, to.col + d.col};
+                for (; empty(from); from.row += d.row, from.col += d.col) {
+                    visit(k, square_index(from));
+                }
+            }
+        };
+
+        switch (piece) {
+        case KING:
+            steps(king_steps);
+            break;
+        case KNIGHT:
+            steps(knight_jumps);
+            break;
+        case QUEEN:
+            rays(rook_dirs);
+            rays(bishop_dirs);
+            break;
+        case ROOK:
+            rays(rook_dirs);
+            break;
+        case BISHOP:
+            rays(bishop_dirs);
+            break;
+        case PAWN: {
+            // white pawns move up, towards row 0
+            Square one = {to.row + 1, to.col};
+            if (one.row <= 6 && empty(one)) {
+                visit(k, square_index(one));
+                Square two = {to.row + 2, to.col};
+                if (two.row == 6 && empty(two)) {
+                    visit(k, square_index(two));
+                }
+            }
+            break;
+        }
+        }
+    }
+};
+
+// taken by reference when filling the tables, so they need a definition
+const int8_t Generator::unknown;
+const int8_t Generator::illegal;
+const int Generator::max_plies;
+const uint32_t Generator::tentative;
+const uint8_t Generator::has_escape;
+
+std::vector<int8_t> generate_table(Endgame e, const Tablebases& known)
+{
+    if (e == KPK && !known.has(KQK)) {
+        throw std::logic_error("KPK needs the KQK table");
+    }
+    return Generator(e, known).run();
+}
+
+void write_table(std::ostream& out, Endgame e, const std::vector<int8_t>& v)
+{
+    TableHeader header;
+    std::memcpy(header.magic, table_magic, sizeof(header.magic));
+    header.endgame = e;
+    header.reserved = 0;
+    header.count = v.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(v.data()), v.size());
+}
+
+Tablebases::Tablebases() :
+    tables()
+{}
+
+int Tablebases::load(const std::string& dir)
+{
+    int found = 0;
+    for (int e = 0; e < ENDGAMES; ++e) {
+        std::string path = dir + "/" + endgame_name(Endgame(e)) + ".tb";
+        if (!std::ifstream(path)) {
+            continue;
+        }
+        // probes jump all over the table
+        std::unique_ptr<MappedFile> file(
+                new MappedFile(path, MappedFile::RANDOM));
+        const TableHeader* header =
+            reinterpret_cast<const TableHeader*>(file->data());
+        if (file->size() < sizeof(TableHeader) ||
+            std::memcmp(header->magic, table_magic, sizeof(table_magic)) ||
+            header->endgame != uint32_t(e) ||
+            header->count != table_size(Endgame(e)) ||
+            file->size() != sizeof(TableHeader) + header->count) {
+            throw std::runtime_error("not a table: " + path);
+        }
+        tables[e] = reinterpret_cast<const int8_t*>(header + 1);
+        files[e] = std::move(file);
+        ++found;
+    }
+    return found;
+}
+
+void Tablebases::add(Endgame e, std::vector<int8_t> values)
+{
+    generated[e] = std::move(values);
+    tables[e] = generated[e].data();
+    files[e].reset();
+}
+
+bool Tablebases::has(Endgame e) const
+{
+    return tables[e];
+}
+
+boost::optional<int> Tablebases::probe(const Board& b, Color to_move) const
+{
+    auto e = classify(b);
+    if (!e || !tables[*e]) {
+        return boost::none;
+    }
+    return int(tables[*e][table_index(*e, placement(*e, b, to_move))]);
+}
+
+boost::optional<Move> tablebase_move(const Tablebases& tb, Board& b, Color c)
+{
+    if (!tb.probe(b, c)) {
+        return boost::none;
+    }
+
+    MoveList moves;
+    generate_legal_moves(b, c, moves);
+    Color opp = c == WHITE ? BLACK : WHITE;
+    boost::optional<Move> best;
+    int best_score = 0;
+    for (const Move& m : moves) {
+        Undo u = apply(b, m);
+        // off the tables means the last piece was taken: a draw
+        int v = tb.probe(b, opp).value_or(0);
+        undo(b, m, u);
+
+        int score = v < 0 ? 1000 + v : v > 0 ? -1000 + v : 0;
+        if (!best || score > best_score) {
+            best = m;
+            best_score = score;
+        }
+    }
+    return best;
+}
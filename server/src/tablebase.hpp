@@ -0,0 +1,62 @@
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+
+#include "chess.hpp"
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+
+// Endgame tables of a king and a few pieces against a bare king, built by
+// retrograde analysis over the rules in chess.cpp.
+//
+// A table holds one byte per position, indexed by side to move and the
+// squares of the strong king, the bare king and the strong side's pieces,
+// with the board flipped so the strong side is white. A value of 0 is a
+// draw, n > 0 means the side to move mates in n plies and n < 0 that it
+// is mated in -n - 1 plies. Illegal positions read as draws.
+//
+// The tables assume neither side can castle; positions where a king and a
+// rook have not moved are not probed.
+enum Endgame
+{
+    KQK, KRK, KPK, KBNK, ENDGAMES
+};
+
+std::string endgame_name(Endgame);
+size_t table_size(Endgame);
+boost::optional<Endgame> classify(const Board&);
+
+class Tablebases;
+
+// KPK promotes into KQK, so it needs that table first.
+std::vector<int8_t> generate_table(Endgame, const Tablebases& known);
+void write_table(std::ostream&, Endgame, const std::vector<int8_t>&);
+
+class Tablebases
+{
+public:
+    Tablebases();
+
+    // Maps the tables found as <dir>/<name>.tb and returns how many there
+    // were. Throws std::runtime_error for a file that is not a table.
+    int load(const std::string& dir);
+    void add(Endgame, std::vector<int8_t>);
+
+    bool has(Endgame) const;
+    boost::optional<int> probe(const Board&, Color to_move) const;
+private:
+    const int8_t* tables[ENDGAMES];
+    std::unique_ptr<MappedFile> files[ENDGAMES];
+    std::vector<int8_t> generated[ENDGAMES];
+};
+
+// The move that keeps the table's result, mating as fast or resisting as
+// long as possible. None if the position is not in a table.
+boost::optional<Move> tablebase_move(const Tablebases&, Board&, Color);
+
+#endif
@@ -0,0 +1,115 @@
+#include "tt.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// data word: move:16 | score:16 | depth:8 | bound:2 | generation:6
+static uint64_t pack(const TranspositionTable::Entry& e, uint8_t generation)
+{
+    return uint64_t(e.move) |
+           uint64_t(uint16_t(e.score)) << 16 |
+           uint64_t(e.depth) << 32 |
+           uint64_t(e.bound & 3) << 40 |
+           uint64_t(generation & 63) << 42;
+}
+
+static TranspositionTable::Entry unpack(uint64_t data)
+{
+    TranspositionTable::Entry e;
+    e.move = uint16_t(data);
+    e.score = int16_t(uint16_t(data >> 16));
+    e.depth = uint8_t(data >> 32);
+    e.bound = uint8_t(data >> 40) & 3;
+    return e;
+}
+
+static uint8_t generation_of(uint64_t data)
+{
+    return uint8_t(data >> 42) & 63;
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes) :
+    mask(0),
+    generation(0)
+{
+    size_t count = 1;
+    while (count * 2 * sizeof(Bucket) <= megabytes << 20) {
+        count *= 2;
+    }
+
+    void* memory = nullptr;
+    if (posix_memalign(&memory, 64, count * sizeof(Bucket)) != 0) {
+        throw std::bad_alloc();
+    }
+    table.reset(static_cast<Bucket*>(memory));
+    mask = count - 1;
+    clear();
+}
+
+void TranspositionTable::Free::operator()(Bucket* buckets) const
+{
+    std::free(buckets);
+}
+
+bool TranspositionTable::probe(uint64_t key, Entry& e) const
+{
+    const Bucket& b = table[key & mask];
+    for (int i = 0; i < bucket_size; ++i) {
+        uint64_t data = b.data[i].load(std::memory_order_relaxed);
+        uint64_t check = b.checks[i].load(std::memory_order_relaxed);
+        if ((check ^ data) == key && data) {
+            e = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Replaces the entry for the same position if there is one, otherwise the
+// shallowest, counting entries from earlier searches as shallower.
+void TranspositionTable::store(uint64_t key, const Entry& e)
+{
+    Bucket& b = table[key & mask];
+    Entry stored = e;
+    int victim = 0;
+    int victim_worth = 1 << 30;
+    for (int i = 0; i < bucket_size; ++i) {
+        uint64_t data = b.data[i].load(std::memory_order_relaxed);
+        uint64_t check = b.checks[i].load(std::memory_order_relaxed);
+        if ((check ^ data) == key) {
+            // a bound without a move keeps the one found earlier
+            if (!stored.move) {
+                stored.move = unpack(data).move;
+            }
+            victim = i;
+            break;
+        }
+        int age = (generation - generation_of(data)) & 63;
+        int worth = unpack(data).depth - 8 * age;
+        if (worth < victim_worth) {
+            victim = i;
+            victim_worth = worth;
+        }
+    }
+
+    uint64_t data = pack(stored, generation);
+    b.data[victim].store(data, std::memory_order_relaxed);
+    b.checks[victim].store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::new_search()
+{
+    generation = (generation + 1) & 63;
+}
+
+void TranspositionTable::clear()
+{
+    std::memset(static_cast<void*>(table.get()), 0,
+                (mask + 1) * sizeof(Bucket));
+}
+
+size_t TranspositionTable::buckets() const
+{
+    return mask + 1;
+}
@@ -0,0 +1,61 @@
+#ifndef TT_HPP
+#define TT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Fixed-size transposition table shared by all search threads without
+// locks.
+//
+// Each entry is two relaxed 64-bit words: the data and the position key
+// XORed with it. A torn write from two threads storing at once leaves a
+// pair that fails the XOR check on the next probe instead of handing out
+// another position's data. Buckets of four entries fill one cache line and
+// are indexed by the low bits of the key, so the bucket count is a power of
+// two.
+class TranspositionTable
+{
+public:
+    enum Bound { EXACT, LOWER, UPPER };
+
+    struct Entry
+    {
+        uint16_t move;
+        int16_t score;
+        uint8_t depth;
+        uint8_t bound;
+    };
+
+    // Rounded down to a power of two buckets, at least one.
+    explicit TranspositionTable(size_t megabytes);
+
+    bool probe(uint64_t key, Entry&) const;
+    void store(uint64_t key, const Entry&);
+
+    // Ages the entries of earlier searches so they are replaced first.
+    void new_search();
+    void clear();
+
+    size_t buckets() const;
+private:
+    static const int bucket_size = 4;
+
+    struct Bucket
+    {
+        std::atomic<uint64_t> checks[bucket_size];
+        std::atomic<uint64_t> data[bucket_size];
+    };
+
+    struct Free
+    {
+        void operator()(Bucket*) const;
+    };
+
+    std::unique_ptr<Bucket[], Free> table;
+    size_t mask;
+    uint8_t generation;
+};
+
+#endif
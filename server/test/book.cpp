@@ -0,0 +1,125 @@
+#include "book.hpp"
+#include "game.hpp"
+#include "pgn.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <gtest/gtest.h>
+
+static SimpleMove san(Board& b, Color c, const char* text)
+{
+    auto m = read_san(b, c, text);
+    EXPECT_TRUE(m) << text;
+    return m ? endpoints(*m) : SimpleMove{{0, 0}, {0, 0}};
+}
+
+TEST(Pgn, ReadsGames)
+{
+    const char* text =
+        "[Event \"Test\"]\n"
+        "[Result \"1-0\"]\n"
+        "\n"
+        "1. e4 {best by test} e5 2. Nf3 (2. f4 exf4) Nc6 $1 3.Bb5 a6 1-0\n"
+        "\n"
+        "[Event \"Second\"]\n"
+        "1. d4 ; comment\n"
+        "d5 *\n"
+        "1. c4\n";
+    PgnReader reader(text);
+    std::vector<boost::string_view> moves;
+
+    ASSERT_TRUE(reader.next_game(moves));
+    std::vector<boost::string_view> expected =
+        {"e4", "e5", "Nf3", "Nc6", "Bb5", "a6"};
+    EXPECT_EQ(expected, moves);
+    EXPECT_EQ("1-0", reader.result());
+
+    ASSERT_TRUE(reader.next_game(moves));
+    expected = {"d4", "d5"};
+    EXPECT_EQ(expected, moves);
+    EXPECT_EQ("*", reader.result());
+
+    ASSERT_TRUE(reader.next_game(moves));
+    expected = {"c4"};
+    EXPECT_EQ(expected, moves);
+    EXPECT_EQ("", reader.result());
+
+    EXPECT_FALSE(reader.next_game(moves));
+}
+
+TEST(Pgn, ResolvesSan)
+{
+    Board b = initial_position();
+    SimpleMove m = san(b, WHITE, "Nf3");
+    EXPECT_EQ(7, m.from.row);
+    EXPECT_EQ(6, m.from.col);
+    EXPECT_EQ(5, m.to.row);
+    EXPECT_EQ(5, m.to.col);
+    EXPECT_FALSE(read_san(b, WHITE, "Ne4"));
+    EXPECT_FALSE(read_san(b, WHITE, "O-O"));
+
+    Board k;
+    k.put({WHITE, KING}, {7, 4});
+    k.put({WHITE, ROOK}, {7, 7});
+    k.put({WHITE, KNIGHT}, {5, 1});
+    k.put({WHITE, KNIGHT}, {5, 5});
+    k.put({WHITE, PAWN}, {1, 0});
+    k.put({BLACK, KING}, {0, 7});
+    k.set_unmoved(square_bit({7, 4}) | square_bit({7, 7}));
+
+    EXPECT_FALSE(read_san(k, WHITE, "Nd4"));
+    m = san(k, WHITE, "Nbd4+");
+    EXPECT_EQ(1, m.from.col);
+    m = san(k, WHITE, "O-O");
+    EXPECT_EQ(6, m.to.col);
+    m = san(k, WHITE, "a8=Q");
+    EXPECT_EQ(0, m.to.row);
+    EXPECT_FALSE(read_san(k, WHITE, "a8=N"));
+}
+
+TEST(Book, WritesAndLooksUp)
+{
+    Board b = initial_position();
+    uint64_t start = b.hash();
+    SimpleMove e4 = {{6, 4}, {4, 4}};
+    SimpleMove d4 = {{6, 3}, {4, 3}};
+    try_move(b, WHITE, e4.from, e4.to);
+
+    std::vector<BookEntry> entries(3, BookEntry());
+    entries[0].key = start;
+    entries[0].move = book_move(d4);
+    entries[0].weight = 1;
+    entries[1].key = b.hash();
+    entries[1].move = book_move({{1, 4}, {3, 4}});
+    entries[1].weight = 5;
+    entries[2].key = start;
+    entries[2].move = book_move(e4);
+    entries[2].weight = 3;
+
+    std::string path = testing::TempDir() + "test.book";
+    {
+        std::ofstream out(path, std::ios::binary);
+        write_book(out, entries);
+    }
+
+    OpeningBook book(path);
+    EXPECT_EQ(3u, book.size());
+    OpeningBook::Range moves = book.lookup(start);
+    ASSERT_EQ(2, moves.second - moves.first);
+    EXPECT_EQ(book_move(e4), moves.first->move);
+    EXPECT_EQ(3, moves.first->weight);
+
+    EXPECT_EQ(book_move(e4), book_move(*book.pick(start, 2)));
+    EXPECT_EQ(book_move(d4), book_move(*book.pick(start, 3)));
+    EXPECT_FALSE(book.pick(start + 1, 0));
+    std::remove(path.c_str());
+
+    EXPECT_THROW(OpeningBook{path}, std::runtime_error);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
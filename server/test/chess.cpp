@@ -1,5 +1,8 @@
 #include "chess.hpp"
+#include "game.hpp"
 
+#include <ostream>
+#include <boost/optional/optional_io.hpp>
 #include <gtest/gtest.h>
 
 bool operator ==(ColoredPiece a, ColoredPiece b)
@@ -7,6 +10,16 @@ bool operator ==(ColoredPiece a, ColoredPiece b)
     return a.color == b.color && a.piece == b.piece;
 }
 
+std::ostream& operator <<(std::ostream& os, Square s)
+{
+    return os << "{" << s.row << ", " << s.col << "}";
+}
+
+std::ostream& operator <<(std::ostream& os, ColoredPiece cp)
+{
+    return os << "{" << cp.color << ", " << cp.piece << "}";
+}
+
 TEST(BoardOperations, MovingPieces)
 {
     Board b;
@@ -210,6 +223,42 @@ TEST(ChessLogic, CantCastleThroughCheck)
     EXPECT_FALSE(move(b, BLACK, {0, 4}, {0, 2}));
 }
 
+TEST(ChessLogic, CantCastleOutOfCheck)
+{
+    Board b;
+    b.put({WHITE, KING}, {7, 4});
+    b.put({WHITE, ROOK}, {7, 7});
+    b.put({WHITE, ROOK}, {7, 0});
+    b.put({BLACK, KING}, {0, 0});
+    EXPECT_TRUE(move(b, WHITE, {7, 4}, {7, 6}));
+    EXPECT_TRUE(move(b, WHITE, {7, 4}, {7, 2}));
+
+    b.put({BLACK, ROOK}, {2, 4});
+    EXPECT_FALSE(move(b, WHITE, {7, 4}, {7, 6}));
+    EXPECT_FALSE(move(b, WHITE, {7, 4}, {7, 2}));
+}
+
+TEST(ChessLogic, SquareAttacked)
+{
+    Board b;
+    b.put({BLACK, PAWN}, {3, 3});
+    b.put({BLACK, KNIGHT}, {0, 0});
+    b.put({BLACK, BISHOP}, {7, 7});
+    b.put({WHITE, PAWN}, {5, 5});
+
+    EXPECT_TRUE(square_attacked(b, {4, 2}, BLACK));
+    EXPECT_TRUE(square_attacked(b, {4, 4}, BLACK));
+    EXPECT_FALSE(square_attacked(b, {4, 3}, BLACK));
+    EXPECT_FALSE(square_attacked(b, {2, 2}, BLACK));
+    EXPECT_TRUE(square_attacked(b, {4, 4}, WHITE));
+    EXPECT_FALSE(square_attacked(b, {6, 4}, WHITE));
+
+    EXPECT_TRUE(square_attacked(b, {1, 2}, BLACK));
+    EXPECT_TRUE(square_attacked(b, {6, 6}, BLACK));
+    EXPECT_TRUE(square_attacked(b, {5, 5}, BLACK));
+    EXPECT_FALSE(square_attacked(b, {3, 3}, BLACK));
+}
+
 TEST(ChessLogic, Check)
 {
     Board b;
@@ -277,13 +326,50 @@ TEST(ChessLogic, Checkmate)
     ASSERT_TRUE(mr1->opponent_cannot_move);
 }
 
+TEST(MoveGeneration, MatchesMoveValidation)
+{
+    Board b = initial_position();
+    b.remove({0, 1}); b.remove({0, 2}); b.remove({0, 3});
+    b.remove({7, 5}); b.remove({7, 6});
+    b.remove({6, 4}); b.remove({1, 3});
+    b.put({WHITE, PAWN}, {1, 7});
+    b.put({BLACK, KNIGHT}, {5, 3});
+
+    for (Color c : {WHITE, BLACK}) {
+        MoveList moves;
+        generate_legal_moves(b, c, moves);
+
+        int expected = 0;
+        for (int i = 0; i < 64; ++i) {
+            for (int j = 0; j < 64; ++j) {
+                Square from = index_square(i), to = index_square(j);
+                auto m = move(b, c, from, to);
+                if (!m) {
+                    continue;
+                }
+                ++expected;
+                bool found = false;
+                for (const Move& gm : moves) {
+                    SimpleMove ends = endpoints(gm);
+                    found = found || (ends.from == from && ends.to == to &&
+                                      gm.hit == m->hit &&
+                                      gm.movement.which() ==
+                                      m->movement.which());
+                }
+                EXPECT_TRUE(found) << from << " -> " << to;
+            }
+        }
+        EXPECT_EQ(expected, moves.size);
+    }
+}
+
 TEST(MoveApplication, ApplySimpleMove)
 {
     Board b;
     ColoredPiece cp1 = {WHITE, QUEEN}, cp2 = {BLACK, QUEEN};
     b.put(cp1, {1, 2}); b.put(cp2, {1, 4});
 
-    apply(b, Move{SimpleMove{{1, 2}, {1, 3}}, boost::none_t()});
+    apply(b, Move{SimpleMove{{1, 2}, {1, 3}}, boost::none});
     EXPECT_FALSE(b.piece_at({1, 2}));
     EXPECT_EQ(cp1, b.piece_at({1, 3}));
     ASSERT_EQ(cp2, b.piece_at({1, 4}));
@@ -302,19 +388,90 @@ TEST(MoveApplication, ApplyCastling)
     b.put(cp1, {7, 4}); b.put(cp2, {7, 7});
     b.put(cp3, {0, 4}); b.put(cp4, {0, 0});
 
-    apply(b, Move{Castle{Square{7, 4}, KINGSIDE}, boost::none_t()});
+    apply(b, Move{Castle{Square{7, 4}, KINGSIDE}, boost::none});
     EXPECT_FALSE(b.piece_at({7, 4}));
     EXPECT_FALSE(b.piece_at({7, 7}));
     EXPECT_EQ(cp1, b.piece_at({7, 6}));
     EXPECT_EQ(cp2, b.piece_at({7, 5}));
 
-    apply(b, Move{Castle{Square{0, 4}, QUEENSIDE}, boost::none_t()});
+    apply(b, Move{Castle{Square{0, 4}, QUEENSIDE}, boost::none});
     EXPECT_FALSE(b.piece_at({0, 4}));
     EXPECT_FALSE(b.piece_at({0, 0}));
     EXPECT_EQ(cp3, b.piece_at({0, 2}));
     EXPECT_EQ(cp4, b.piece_at({0, 3}));
 }
 
+TEST(MoveApplication, UndoRestoresBoard)
+{
+    Board b = initial_position();
+    b.remove({7, 5}); b.remove({7, 6});
+    b.put({BLACK, ROOK}, {5, 4});
+    b.put({WHITE, PAWN}, {1, 7});
+    b.remove({0, 7});
+
+    Move moves[] = {
+        Move{SimpleMove{{6, 3}, {5, 4}}, Square{5, 4}},
+        Move{SimpleMove{{6, 0}, {4, 0}}, boost::none},
+        Move{Castle{Square{7, 4}, KINGSIDE}, boost::none},
+        Move{Promotion{{1, 7}, {0, 6}, WHITE}, Square{0, 6}},
+        Move{Promotion{{1, 7}, {0, 7}, WHITE}, boost::none}
+    };
+    for (const Move& m : moves) {
+        Board before = b;
+        Undo u = apply(b, m);
+        undo(b, m, u);
+        for (int i = 0; i < 64; ++i) {
+            Square s = index_square(i);
+            EXPECT_EQ(before.piece_at(s), b.piece_at(s)) << s;
+            EXPECT_EQ(before.has_moved(s), b.has_moved(s)) << s;
+        }
+    }
+}
+
+TEST(Hashing, IncrementalMatchesRecomputed)
+{
+    Board b = initial_position();
+    EXPECT_EQ(b.compute_hash(), b.hash());
+
+    const char* game[][2] = {
+        {"e2", "e4"}, {"d7", "d5"}, {"e4", "d5"}, {"d8", "d5"},
+        {"g1", "f3"}, {"c8", "g4"}, {"f1", "e2"}, {"b8", "c6"},
+        {"e1", "g1"}, {"e8", "c8"}
+    };
+    Color c = WHITE;
+    for (auto& m : game) {
+        ASSERT_TRUE(try_move(b, c, *read_square(m[0]), *read_square(m[1])));
+        EXPECT_EQ(b.compute_hash(), b.hash());
+        c = c == WHITE ? BLACK : WHITE;
+    }
+
+    b.put({WHITE, QUEEN}, {3, 3});
+    EXPECT_EQ(b.compute_hash(), b.hash());
+    b.remove({3, 3});
+    EXPECT_EQ(b.compute_hash(), b.hash());
+}
+
+TEST(Hashing, IdentifiesPositions)
+{
+    Board b1 = initial_position(), b2 = initial_position();
+    ASSERT_TRUE(try_move(b1, WHITE, {7, 6}, {5, 5}));
+    ASSERT_TRUE(try_move(b1, BLACK, {0, 6}, {2, 5}));
+    ASSERT_TRUE(try_move(b1, WHITE, {5, 5}, {7, 6}));
+    ASSERT_TRUE(try_move(b1, BLACK, {2, 5}, {0, 6}));
+    EXPECT_EQ(b2.hash(), b1.hash());
+
+    ASSERT_TRUE(try_move(b1, WHITE, {7, 6}, {5, 5}));
+    EXPECT_NE(b2.hash(), b1.hash());
+
+    // the same pieces on the same squares, but the h1 rook has moved
+    Board b3 = initial_position(), b4 = initial_position();
+    b3.remove({6, 7}); b4.remove({6, 7});
+    b3.move({7, 7}, {6, 7}); b3.move({6, 7}, {7, 7});
+    EXPECT_EQ(b4.occupied(), b3.occupied());
+    EXPECT_EQ(b4.pieces(WHITE, ROOK), b3.pieces(WHITE, ROOK));
+    EXPECT_NE(b4.hash(), b3.hash());
+}
+
 TEST(MoveApplication, ApplyPromotion)
 {
     Board b;
@@ -0,0 +1,166 @@
+#include "engine.hpp"
+#include "position.hpp"
+
+#include <gtest/gtest.h>
+
+static const SearchLimits limits = {std::chrono::milliseconds(2000), 4};
+
+TEST(Engine, EvaluationIsSymmetric)
+{
+    Board b = initial_position();
+    EXPECT_EQ(0, evaluate(b, WHITE));
+    EXPECT_EQ(0, evaluate(b, BLACK));
+
+    b.remove({7, 3});
+    EXPECT_LT(evaluate(b, WHITE), -800);
+    EXPECT_EQ(-evaluate(b, WHITE), evaluate(b, BLACK));
+}
+
+TEST(Engine, FindsMateInOne)
+{
+    Board b;
+    b.put({BLACK, KING}, {0, 6});
+    b.put({BLACK, PAWN}, {1, 5});
+    b.put({BLACK, PAWN}, {1, 6});
+    b.put({BLACK, PAWN}, {1, 7});
+    b.put({WHITE, KING}, {7, 6});
+    b.put({WHITE, ROOK}, {7, 0});
+
+    SearchResult r = search(b, WHITE, limits);
+    ASSERT_TRUE(r.best);
+    SimpleMove m = endpoints(*r.best);
+    EXPECT_EQ(7, m.from.row);
+    EXPECT_EQ(0, m.from.col);
+    EXPECT_EQ(0, m.to.row);
+    EXPECT_EQ(0, m.to.col);
+    EXPECT_EQ(mate_score - 1, r.score);
+}
+
+TEST(Engine, TakesHangingQueen)
+{
+    Board b;
+    b.put({BLACK, KING}, {0, 7});
+    b.put({BLACK, QUEEN}, {3, 3});
+    b.put({WHITE, KING}, {7, 6});
+    b.put({WHITE, ROOK}, {7, 3});
+
+    SearchResult r = search(b, WHITE, limits);
+    ASSERT_TRUE(r.best);
+    EXPECT_TRUE(r.best->hit);
+    EXPECT_EQ(3, endpoints(*r.best).to.row);
+    EXPECT_EQ(3, endpoints(*r.best).to.col);
+    EXPECT_GT(r.score, 300);
+}
+
+TEST(Engine, NoMoveWhenMatedOrStalemated)
+{
+    Board mated;
+    mated.put({BLACK, KING}, {0, 0});
+    mated.put({WHITE, QUEEN}, {1, 1});
+    mated.put({WHITE, KING}, {2, 2});
+    EXPECT_FALSE(search(mated, BLACK, limits).best);
+
+    Board stalemated;
+    stalemated.put({BLACK, KING}, {0, 0});
+    stalemated.put({WHITE, QUEEN}, {2, 1});
+    stalemated.put({WHITE, KING}, {1, 2});
+    EXPECT_FALSE(search(stalemated, BLACK, limits).best);
+}
+
+TEST(Engine, RespectsTimeBudget)
+{
+    SearchLimits quick = {std::chrono::milliseconds(50), 64};
+    SearchResult r = search(initial_position(), WHITE, quick);
+    ASSERT_TRUE(r.best);
+    EXPECT_GE(r.depth, 1);
+    EXPECT_LT(r.seconds, 0.5);
+}
+
+TEST(Engine, MovesWithNoTimeLeft)
+{
+    // enough captures that time runs out inside the first move searched
+    auto b = from_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/"
+                      "R3K2R w KQkq - 0 1");
+    ASSERT_TRUE(b);
+    for (int threads = 1; threads <= 4; threads += 3) {
+        SearchLimits none = {std::chrono::milliseconds(0), 64, threads};
+        SearchResult r = search(*b, WHITE, none);
+        ASSERT_TRUE(r.best) << threads;
+        SimpleMove m = endpoints(*r.best);
+        EXPECT_TRUE(move(*b, WHITE, m.from, m.to)) << threads;
+    }
+}
+
+TEST(TranspositionTable, StoresAndProbes)
+{
+    TranspositionTable tt(1);
+    EXPECT_EQ(1u << 14, tt.buckets());
+
+    TranspositionTable::Entry e = {0x8123, -517, 7, TranspositionTable::LOWER};
+    TranspositionTable::Entry found;
+    EXPECT_FALSE(tt.probe(42, found));
+    tt.store(42, e);
+    ASSERT_TRUE(tt.probe(42, found));
+    EXPECT_EQ(0x8123, found.move);
+    EXPECT_EQ(-517, found.score);
+    EXPECT_EQ(7, found.depth);
+    EXPECT_EQ(TranspositionTable::LOWER, found.bound);
+
+    // same bucket, different position
+    EXPECT_FALSE(tt.probe(42 + tt.buckets(), found));
+
+    tt.clear();
+    EXPECT_FALSE(tt.probe(42, found));
+}
+
+TEST(TranspositionTable, KeepsDeepEntriesInFullBucket)
+{
+    TranspositionTable tt(1);
+    uint64_t step = tt.buckets();
+    for (int i = 0; i < 4; ++i) {
+        TranspositionTable::Entry e = {0, 0, uint8_t(10 + i),
+                                       TranspositionTable::EXACT};
+        tt.store(1 + i * step, e);
+    }
+    TranspositionTable::Entry shallow = {0, 0, 1, TranspositionTable::EXACT};
+    tt.store(1 + 4 * step, shallow);
+
+    TranspositionTable::Entry found;
+    EXPECT_FALSE(tt.probe(1, found));
+    for (int i = 1; i <= 4; ++i) {
+        EXPECT_TRUE(tt.probe(1 + i * step, found));
+    }
+}
+
+TEST(Engine, ParallelSearchAgrees)
+{
+    Board b;
+    b.put({BLACK, KING}, {0, 6});
+    b.put({BLACK, PAWN}, {1, 5});
+    b.put({BLACK, PAWN}, {1, 6});
+    b.put({BLACK, PAWN}, {1, 7});
+    b.put({WHITE, KING}, {7, 6});
+    b.put({WHITE, ROOK}, {7, 0});
+
+    SearchLimits parallel = {std::chrono::milliseconds(2000), 4, 4};
+    SearchResult r = search(b, WHITE, parallel);
+    ASSERT_TRUE(r.best);
+    EXPECT_EQ(0, endpoints(*r.best).to.row);
+    EXPECT_EQ(0, endpoints(*r.best).to.col);
+    EXPECT_EQ(mate_score - 1, r.score);
+
+    TranspositionTable tt(1);
+    SearchLimits deep = {std::chrono::milliseconds(5000), 5, 1};
+    Board start = initial_position();
+    SearchResult first = search(start, WHITE, deep, tt);
+    SearchResult again = search(start, WHITE, deep, tt);
+    EXPECT_EQ(5, first.depth);
+    EXPECT_EQ(5, again.depth);
+    EXPECT_LT(again.nodes, first.nodes);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,131 @@
+#include "game.hpp"
+#include "protocol.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(Parsing, ReadSquare)
+{
+    auto s = read_square("e2");
+    ASSERT_TRUE(s);
+    EXPECT_EQ(6, s->row);
+    EXPECT_EQ(4, s->col);
+
+    EXPECT_FALSE(read_square("e9"));
+    EXPECT_FALSE(read_square("E2"));
+    EXPECT_FALSE(read_square("e22"));
+}
+
+TEST(Parsing, Tokenizer)
+{
+    Tokenizer t(" \tsay  hello\r\n");
+    boost::string_view word;
+    ASSERT_TRUE(t.next(word));
+    EXPECT_EQ("say", word);
+    EXPECT_EQ("hello\r\n", t.rest());
+    ASSERT_TRUE(t.next(word));
+    EXPECT_EQ("hello", word);
+    EXPECT_FALSE(t.next(word));
+}
+
+TEST(Parsing, MoveCommand)
+{
+    Command cmd = read_command("move  e2 e4\r");
+    EXPECT_EQ(MOVE, cmd.type);
+    EXPECT_EQ(2, cmd.args);
+    ASSERT_TRUE(cmd.from && cmd.to);
+    EXPECT_EQ(6, cmd.from->row);
+    EXPECT_EQ(4, cmd.to->row);
+
+    cmd = read_command("move e2");
+    EXPECT_EQ(MOVE, cmd.type);
+    EXPECT_EQ(1, cmd.args);
+
+    cmd = read_command("move e2 x");
+    EXPECT_EQ(2, cmd.args);
+    EXPECT_FALSE(cmd.to);
+}
+
+TEST(Parsing, OtherCommands)
+{
+    EXPECT_EQ(READY, read_command("ready").type);
+    EXPECT_EQ(RESIGN, read_command(" resign ").type);
+    EXPECT_EQ(UNKNOWN, read_command("").type);
+    EXPECT_EQ(UNKNOWN, read_command("   ").type);
+    EXPECT_EQ(UNKNOWN, read_command("castle").type);
+
+    Command cmd = read_command("say  hi   there ");
+    EXPECT_EQ(SAY, cmd.type);
+    EXPECT_EQ("hi   there ", cmd.text);
+}
+
+TEST(Protocol, TextReplies)
+{
+    Reply r = Reply();
+    r.type = SAID;
+    r.player = 2;
+    r.text = "hi there";
+    EXPECT_EQ("say2 hi there", show(r));
+    r.text = "";
+    EXPECT_EQ("say2", show(r));
+
+    r.type = MOVED;
+    r.result.move = Move{Castle{Square{7, 4}, KINGSIDE}, boost::none};
+    r.result.gave_check = true;
+    EXPECT_EQ("castle kingside check", show(r));
+
+    r.type = ADJUDICATED;
+    r.color = BLACK;
+    EXPECT_EQ("adjudicated black", show(r));
+    r.draw = true;
+    EXPECT_EQ("adjudicated draw", show(r));
+    EXPECT_EQ(binary::adjudicated_draw, binary::encode(r)[3]);
+
+    r.type = BAD_MOVE;
+    EXPECT_EQ("error move", show(r));
+}
+
+TEST(Protocol, BinaryMoveReply)
+{
+    Reply r = Reply();
+    r.type = MOVED;
+    r.result.move = Move{Promotion{{1, 0}, {0, 1}, WHITE}, Square{0, 1}};
+    r.result.gave_check = true;
+    r.result.opponent_cannot_move = true;
+
+    std::string frame = binary::encode(r);
+    ASSERT_EQ(binary::header_size + 4, frame.size());
+    EXPECT_EQ(4u, binary::payload_size(frame.data()));
+    EXPECT_EQ(binary::OP_MOVED, frame[2]);
+    EXPECT_EQ(8, frame[3]);
+    EXPECT_EQ(1, frame[4]);
+    EXPECT_EQ(binary::HIT | binary::PROMOTION | binary::CHECK |
+              binary::CANNOT_MOVE, frame[5]);
+}
+
+TEST(Protocol, BinaryCommands)
+{
+    const char move[] = {binary::OP_MOVE, 52, 36};
+    Command cmd = binary::read_frame(boost::string_view(move, 3));
+    EXPECT_EQ(MOVE, cmd.type);
+    EXPECT_EQ(2, cmd.args);
+    ASSERT_TRUE(cmd.from && cmd.to);
+    EXPECT_EQ(6, cmd.from->row);
+    EXPECT_EQ(4, cmd.to->row);
+
+    const char bad_move[] = {binary::OP_MOVE, 52, 64};
+    EXPECT_FALSE(binary::read_frame(boost::string_view(bad_move, 3)).to);
+
+    const char say[] = {binary::OP_SAY, 'h', 'i'};
+    cmd = binary::read_frame(boost::string_view(say, 3));
+    EXPECT_EQ(SAY, cmd.type);
+    EXPECT_EQ("hi", cmd.text);
+
+    EXPECT_EQ(UNKNOWN, binary::read_frame("").type);
+    EXPECT_EQ(UNKNOWN, binary::read_frame("\x09").type);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,152 @@
+#include "journal.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// one file per run, so runs side by side do not share it
+static const std::string path = testing::TempDir() + "test_journal." +
+                                std::to_string(getpid()) + ".log";
+
+static SimpleMove move(const char* from, const char* to)
+{
+    return SimpleMove{{8 - (from[1] - '0'), from[0] - 'a'},
+                      {8 - (to[1] - '0'), to[0] - 'a'}};
+}
+
+static Board played(std::initializer_list<SimpleMove> moves)
+{
+    Board b = initial_position();
+    Color c = WHITE;
+    for (SimpleMove m : moves) {
+        EXPECT_TRUE(try_move(b, c, m.from, m.to));
+        c = c == WHITE ? BLACK : WHITE;
+    }
+    return b;
+}
+
+TEST(Journal, RecoversLiveGames)
+{
+    {
+        Journal journal(path, {});
+        journal.started(1, WHITE);
+        journal.started(2, BLACK);
+        journal.started(3, WHITE);
+        journal.moved(1, move("e2", "e4"));
+        journal.moved(2, move("d2", "d4"));
+        journal.moved(1, move("e7", "e5"));
+        journal.ended(3);
+        journal.moved(1, move("g1", "f3"));
+        // not legal, so game 2 is given up
+        journal.moved(2, move("d4", "d3"));
+        journal.sync();
+        EXPECT_LE(journal.commits(), 9u);
+    }
+
+    for (int threads : {1, 2, 5}) {
+        auto games = recover_journal(path, threads);
+        ASSERT_EQ(1u, games.size());
+        EXPECT_EQ(1, games[0].room);
+        EXPECT_EQ(WHITE, games[0].player1);
+        EXPECT_EQ(BLACK, games[0].turn);
+        EXPECT_EQ(3u, games[0].moves.size());
+        Board expected = played({move("e2", "e4"), move("e7", "e5"),
+                                 move("g1", "f3")});
+        EXPECT_EQ(expected.hash(), games[0].board.hash());
+    }
+    std::remove(path.c_str());
+}
+
+TEST(Journal, StopsAtTornRecord)
+{
+    {
+        Journal journal(path, {});
+        journal.started(7, BLACK);
+        journal.moved(7, move("e2", "e4"));
+    }
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        JournalRecord torn = journal_record(7, JournalRecord::END);
+        torn.check ^= 1;
+        out.write(reinterpret_cast<const char*>(&torn), sizeof(torn));
+        // half a record
+        out.write(reinterpret_cast<const char*>(&torn), 3);
+    }
+
+    auto games = recover_journal(path, 2);
+    ASSERT_EQ(1u, games.size());
+    EXPECT_EQ(BLACK, games[0].player1);
+    EXPECT_EQ(BLACK, games[0].turn);
+    std::remove(path.c_str());
+
+    EXPECT_TRUE(recover_journal(path, 2).empty());
+}
+
+TEST(Journal, CarriesOverRecoveredGames)
+{
+    {
+        Journal journal(path, {});
+        journal.started(4, WHITE);
+        journal.moved(4, move("e2", "e4"));
+        journal.started(5, WHITE);
+        journal.ended(5);
+    }
+    auto games = recover_journal(path, 1);
+    ASSERT_EQ(1u, games.size());
+    {
+        Journal journal(path, games);
+        journal.moved(4, move("c7", "c5"));
+    }
+    // only the live game is carried over, and moves go on after it
+    std::ifstream in(path, std::ios::ate | std::ios::binary);
+    EXPECT_EQ(3 * sizeof(JournalRecord), size_t(in.tellg()));
+
+    games = recover_journal(path, 1);
+    ASSERT_EQ(1u, games.size());
+    EXPECT_EQ(2u, games[0].moves.size());
+    EXPECT_EQ(WHITE, games[0].turn);
+    std::remove(path.c_str());
+}
+
+TEST(Journal, ReportsFailedCommits)
+{
+    // past the size limit writes fail with EFBIG, instead of raising
+    // SIGXFSZ
+    std::signal(SIGXFSZ, SIG_IGN);
+    rlimit unlimited, small;
+    ASSERT_EQ(0, getrlimit(RLIMIT_FSIZE, &unlimited));
+    small = unlimited;
+    small.rlim_cur = 2 * sizeof(JournalRecord);
+    {
+        Journal journal(path, {});
+        ASSERT_EQ(0, setrlimit(RLIMIT_FSIZE, &small));
+        journal.started(6, WHITE);
+        journal.moved(6, move("e2", "e4"));
+        journal.sync();
+        uint64_t commits = journal.commits();
+
+        journal.moved(6, move("e7", "e5"));
+        EXPECT_THROW(journal.sync(), std::runtime_error);
+        // nothing more is committed
+        journal.ended(6);
+        EXPECT_THROW(journal.sync(), std::runtime_error);
+        EXPECT_EQ(commits, journal.commits());
+    }
+    setrlimit(RLIMIT_FSIZE, &unlimited);
+
+    auto games = recover_journal(path, 1);
+    ASSERT_EQ(1u, games.size());
+    EXPECT_EQ(1u, games[0].moves.size());
+    std::remove(path.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+#include "metrics.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+using metrics::Histogram;
+
+TEST(Metrics, BucketsAreLogarithmic)
+{
+    for (uint64_t v = 0; v < 16; ++v) {
+        EXPECT_EQ(int(v), Histogram::bucket(v));
+    }
+    EXPECT_EQ(16, Histogram::bucket(16));
+    EXPECT_EQ(Histogram::bucket(1000), Histogram::bucket(1020));
+    EXPECT_EQ(Histogram::buckets - 1, Histogram::bucket(~uint64_t(0)));
+
+    uint64_t values[] = {17, 100, 12345, 987654321, uint64_t(1) << 50};
+    for (uint64_t v : values) {
+        int b = Histogram::bucket(v);
+        EXPECT_LE(Histogram::lower_bound(b), v);
+        EXPECT_GT(Histogram::lower_bound(b + 1), v);
+        // within 1/16 of the value
+        EXPECT_LE(v - Histogram::lower_bound(b), v / 16);
+    }
+}
+
+static uint64_t value(const std::string& report, const std::string& name)
+{
+    size_t at = report.find("\n" + name + " ");
+    EXPECT_NE(std::string::npos, at) << name;
+    return at == std::string::npos ? 0 :
+           std::stoull(report.substr(at + name.size() + 2));
+}
+
+TEST(Metrics, SumsThreads)
+{
+    std::string before = metrics::report();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 1000; ++i) {
+                metrics::add(metrics::BYTES_OUT, 3);
+                metrics::record(metrics::MOVE_LATENCY,
+                                std::chrono::microseconds(100));
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    metrics::add(metrics::ROOMS_OPENED, 2);
+    metrics::add(metrics::ROOMS_CLOSED);
+
+    std::string after = "\n" + metrics::report();
+    EXPECT_EQ(12000u, value(after, "bytes_out") -
+                      value("\n" + before, "bytes_out"));
+    EXPECT_EQ(1u, value(after, "rooms_active"));
+    EXPECT_EQ(4000u, value(after, "command_latency_us_count{command=\"move\"}"));
+    size_t p99 = after.find("command_latency_us{command=\"move\","
+                            "quantile=\"0.99\"} ");
+    ASSERT_NE(std::string::npos, p99);
+    double us = std::stod(after.substr(after.find("} ", p99) + 2));
+    EXPECT_NEAR(100, us, 100 / 16.0);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+#include "game.hpp"
+#include "position.hpp"
+
+#include <cstring>
+#include <gtest/gtest.h>
+
+static void play(Board& b, Color c, const char* from, const char* to)
+{
+    ASSERT_TRUE(try_move(b, c, *read_square(from), *read_square(to)))
+        << from << to;
+}
+
+TEST(Fen, ReadsInitialPosition)
+{
+    auto b = from_fen(initial_fen);
+    ASSERT_TRUE(b);
+    EXPECT_EQ(initial_position().hash(), b->hash());
+    EXPECT_EQ(initial_fen, to_fen(initial_position()));
+    EXPECT_FALSE(b->has_moved(*read_square("e2")));
+    EXPECT_TRUE(b->has_moved(*read_square("g1")));
+}
+
+TEST(Fen, MatchesPlayedPositions)
+{
+    Board b = initial_position();
+    play(b, WHITE, "e2", "e4");
+    play(b, BLACK, "e7", "e5");
+    play(b, WHITE, "g1", "f3");
+    play(b, BLACK, "b8", "c6");
+    play(b, WHITE, "f1", "c4");
+    play(b, BLACK, "g8", "f6");
+    play(b, WHITE, "e1", "g1");
+    const char* fen =
+        "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQ1RK1 b kq - 0 1";
+    EXPECT_EQ(fen, to_fen(b));
+
+    auto read = from_fen(fen);
+    ASSERT_TRUE(read);
+    EXPECT_EQ(b.hash(), read->hash());
+    EXPECT_EQ(BLACK, read->side_to_move());
+    // moves still work from the position read
+    play(*read, BLACK, "f8", "c5");
+    EXPECT_TRUE(from_fen("8/8/8/8/8/8/8/K6k w - -"));
+    EXPECT_TRUE(from_fen("8/8/8/8/8/8/8/K6k b"));
+}
+
+TEST(Fen, RejectsMalformed)
+{
+    EXPECT_FALSE(from_fen(""));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/8/K6k"));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/8/K6k x"));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/K6k w"));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/8/K7k w"));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/8/K5k w"));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/8/K5xk w"));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/8/8 w"));
+    EXPECT_FALSE(from_fen("P7/8/8/8/8/8/8/K6k w"));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/8/K6k w K"));
+    EXPECT_FALSE(from_fen("8/8/8/8/8/8/8/4K2R w X"));
+}
+
+TEST(Snapshot, RestoresBoards)
+{
+    Board b = initial_position();
+    play(b, WHITE, "e2", "e4");
+    play(b, BLACK, "d7", "d5");
+    play(b, WHITE, "e4", "d5");
+
+    BoardSnapshot s = snapshot(b);
+    auto restored = from_snapshot(s);
+    ASSERT_TRUE(restored);
+    EXPECT_EQ(b.hash(), restored->hash());
+    EXPECT_EQ(b.unmoved_pieces(), restored->unmoved_pieces());
+    EXPECT_EQ(to_fen(b), to_fen(*restored));
+
+    s.squares[10] = 0xd0;
+    EXPECT_FALSE(from_snapshot(s));
+    s = snapshot(b);
+    s.side = 2;
+    EXPECT_FALSE(from_snapshot(s));
+
+    // no white king, then two
+    s = snapshot(b);
+    s.squares[30] = 0x00;
+    EXPECT_FALSE(from_snapshot(s));
+    s.squares[30] = 0x11;
+    EXPECT_FALSE(from_snapshot(s));
+}
+
+TEST(Snapshot, RestoresGames)
+{
+    Board b = initial_position();
+    play(b, WHITE, "e2", "e4");
+    Game game;
+    game.resume(BLACK, b, BLACK);
+
+    GameSnapshot s = game.snapshot();
+    Game restored;
+    ASSERT_TRUE(restored.restore(s));
+    EXPECT_TRUE(restored.is_playing());
+    EXPECT_EQ(BLACK, restored.color(1));
+    EXPECT_EQ(WHITE, restored.color(2));
+    EXPECT_EQ(BLACK, restored.turn());
+    EXPECT_EQ(b.hash(), restored.position().hash());
+
+    s.turn = 7;
+    EXPECT_FALSE(restored.restore(s));
+    EXPECT_EQ(BLACK, restored.turn());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
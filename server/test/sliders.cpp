@@ -0,0 +1,68 @@
+#include "sliders.hpp"
+
+#include <random>
+#include <gtest/gtest.h>
+
+static Bitboard walk(int square, Bitboard occupied, int first_dir)
+{
+    static const Square dirs[8] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1},
+                                   {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+    Square s = index_square(square);
+    Bitboard attacks = 0;
+    for (int d = first_dir; d < first_dir + 4; ++d) {
+        Square to = {s.row + dirs[d].row, s.col + dirs[d].col};
+        for (; on_board(to); to.row += dirs[d].row, to.col += dirs[d].col) {
+            attacks |= square_bit(to);
+            if (occupied & square_bit(to)) {
+                break;
+            }
+        }
+    }
+    return attacks;
+}
+
+static void expect_walked_attacks()
+{
+    std::mt19937_64 random(1);
+    for (int i = 0; i < 20000; ++i) {
+        // sparse and dense boards alike
+        Bitboard occupied = random() & random();
+        if (i % 2) {
+            occupied |= random();
+        }
+        int s = int(random() % 64);
+        ASSERT_EQ(walk(s, occupied, 0), rook_attacks(s, occupied)) << s;
+        ASSERT_EQ(walk(s, occupied, 4), bishop_attacks(s, occupied)) << s;
+    }
+    for (int s = 0; s < 64; ++s) {
+        ASSERT_EQ(walk(s, 0, 0), rook_attacks(s, 0)) << s;
+        ASSERT_EQ(walk(s, ~Bitboard(0), 4), bishop_attacks(s, ~Bitboard(0)));
+    }
+}
+
+TEST(Sliders, MagicLookupMatchesWalkingRays)
+{
+    SlidingLookup lookup = sliding_lookup();
+    ASSERT_TRUE(use_sliding_lookup(MAGIC_LOOKUP));
+    expect_walked_attacks();
+    use_sliding_lookup(lookup);
+}
+
+TEST(Sliders, PextLookupMatchesWalkingRays)
+{
+    SlidingLookup lookup = sliding_lookup();
+    if (!use_sliding_lookup(PEXT_LOOKUP)) {
+        EXPECT_FALSE(pext_supported());
+        EXPECT_EQ(lookup, sliding_lookup());
+        return;
+    }
+    EXPECT_EQ(PEXT_LOOKUP, sliding_lookup());
+    expect_walked_attacks();
+    use_sliding_lookup(lookup);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,181 @@
+#include "tablebase.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+
+// Generating KQK and KPK takes a couple of seconds, so it happens once.
+static const Tablebases& tables()
+{
+    static Tablebases tb;
+    static bool generated = false;
+    if (!generated) {
+        tb.add(KQK, generate_table(KQK, tb));
+        tb.add(KPK, generate_table(KPK, tb));
+        generated = true;
+    }
+    return tb;
+}
+
+static Board position(std::initializer_list<std::pair<ColoredPiece, Square>>
+                      pieces)
+{
+    Board b;
+    for (const auto& p : pieces) {
+        b.put(p.first, p.second);
+    }
+    b.set_unmoved(0);
+    return b;
+}
+
+TEST(Tablebase, Classifies)
+{
+    EXPECT_FALSE(classify(initial_position()));
+    EXPECT_EQ(KQK, *classify(position({{{BLACK, KING}, {0, 0}},
+                                       {{BLACK, QUEEN}, {3, 3}},
+                                       {{WHITE, KING}, {7, 7}}})));
+    EXPECT_EQ(KBNK, *classify(position({{{WHITE, KING}, {0, 0}},
+                                        {{WHITE, KNIGHT}, {3, 3}},
+                                        {{WHITE, BISHOP}, {3, 4}},
+                                        {{BLACK, KING}, {7, 7}}})));
+    EXPECT_FALSE(classify(position({{{WHITE, KING}, {0, 0}},
+                                    {{WHITE, BISHOP}, {3, 3}},
+                                    {{WHITE, BISHOP}, {3, 4}},
+                                    {{BLACK, KING}, {7, 7}}})));
+
+    // castling would be possible
+    Board unmoved;
+    unmoved.put({WHITE, KING}, {7, 4});
+    unmoved.put({WHITE, ROOK}, {7, 7});
+    unmoved.put({BLACK, KING}, {0, 0});
+    EXPECT_FALSE(classify(unmoved));
+}
+
+TEST(Tablebase, KnowsMates)
+{
+    const Tablebases& tb = tables();
+    // Qb7 mate, protected by the king
+    Board mated = position({{{BLACK, KING}, {0, 0}},
+                            {{WHITE, QUEEN}, {1, 1}},
+                            {{WHITE, KING}, {2, 2}}});
+    EXPECT_EQ(-1, *tb.probe(mated, BLACK));
+
+    Board mate_in_one = position({{{BLACK, KING}, {0, 0}},
+                                  {{WHITE, QUEEN}, {3, 1}},
+                                  {{WHITE, KING}, {2, 2}}});
+    EXPECT_EQ(1, *tb.probe(mate_in_one, WHITE));
+    auto m = tablebase_move(tb, mate_in_one, WHITE);
+    ASSERT_TRUE(m);
+    Undo u = apply(mate_in_one, *m);
+    EXPECT_EQ(-1, *tb.probe(mate_in_one, BLACK));
+    undo(mate_in_one, *m, u);
+
+    // the same with colors and rows swapped
+    Board flipped = position({{{WHITE, KING}, {7, 0}},
+                              {{BLACK, QUEEN}, {4, 1}},
+                              {{BLACK, KING}, {5, 2}}});
+    EXPECT_EQ(1, *tb.probe(flipped, BLACK));
+
+    Board stalemate = position({{{BLACK, KING}, {0, 0}},
+                                {{WHITE, QUEEN}, {2, 1}},
+                                {{WHITE, KING}, {1, 2}}});
+    EXPECT_EQ(0, *tb.probe(stalemate, BLACK));
+
+    // the bare king takes the queen
+    Board hanging = position({{{BLACK, KING}, {0, 0}},
+                              {{WHITE, QUEEN}, {1, 1}},
+                              {{WHITE, KING}, {7, 7}}});
+    EXPECT_EQ(0, *tb.probe(hanging, BLACK));
+}
+
+TEST(Tablebase, KnowsPawnEndings)
+{
+    const Tablebases& tb = tables();
+    Board corner = position({{{BLACK, KING}, {0, 0}},
+                             {{WHITE, PAWN}, {6, 0}},
+                             {{WHITE, KING}, {7, 7}}});
+    EXPECT_EQ(0, *tb.probe(corner, WHITE));
+    EXPECT_EQ(0, *tb.probe(corner, BLACK));
+
+    Board runs = position({{{BLACK, KING}, {7, 7}},
+                           {{WHITE, PAWN}, {1, 0}},
+                           {{WHITE, KING}, {1, 2}}});
+    EXPECT_GT(*tb.probe(runs, WHITE), 0);
+}
+
+// Every entry follows from the entries after each legal move.
+TEST(Tablebase, ConsistentWithMoves)
+{
+    const Tablebases& tb = tables();
+    int checked = 0;
+    for (int wk = 0; wk < 64; wk += 3) {
+        for (int bk = 0; bk < 64; bk += 5) {
+            for (int q = 0; q < 64; q += 2) {
+                if (wk == bk || wk == q || bk == q) {
+                    continue;
+                }
+                Board b = position({{{WHITE, KING}, index_square(wk)},
+                                    {{BLACK, KING}, index_square(bk)},
+                                    {{WHITE, QUEEN}, index_square(q)}});
+                for (Color c : {WHITE, BLACK}) {
+                    Color opp = c == WHITE ? BLACK : WHITE;
+                    if (in_check(b, opp)) {
+                        continue;
+                    }
+                    MoveList moves;
+                    generate_legal_moves(b, c, moves);
+                    int expected = moves.empty() && in_check(b, c) ? -1 : 0;
+                    bool win = false, all_lose = !moves.empty();
+                    int fastest = 1000, longest = 0;
+                    for (const Move& m : moves) {
+                        Undo u = apply(b, m);
+                        int v = tb.probe(b, opp).value_or(0);
+                        undo(b, m, u);
+                        if (v < 0) {
+                            win = true;
+                            fastest = std::min(fastest, -v);
+                        }
+                        if (v <= 0) {
+                            all_lose = false;
+                        }
+                        longest = std::max(longest, v + 1);
+                    }
+                    if (win) {
+                        expected = fastest;
+                    } else if (all_lose) {
+                        expected = -longest - 1;
+                    }
+                    ASSERT_EQ(expected, *tb.probe(b, c));
+                    ++checked;
+                }
+            }
+        }
+    }
+    EXPECT_GT(checked, 3000);
+}
+
+TEST(Tablebase, LoadsWrittenTables)
+{
+    std::string dir = testing::TempDir();
+    std::string path = dir + "/KQK.tb";
+    {
+        std::ofstream out(path, std::ios::binary);
+        write_table(out, KQK, generate_table(KQK, Tablebases()));
+    }
+    Tablebases tb;
+    EXPECT_EQ(1, tb.load(dir));
+    EXPECT_TRUE(tb.has(KQK));
+    EXPECT_FALSE(tb.has(KRK));
+
+    Board mated = position({{{BLACK, KING}, {0, 0}},
+                            {{WHITE, QUEEN}, {1, 1}},
+                            {{WHITE, KING}, {2, 2}}});
+    EXPECT_EQ(-1, *tb.probe(mated, BLACK));
+    std::remove(path.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,124 @@
+#include "chess.hpp"
+#include "engine.hpp"
+#include "game.hpp"
+#include "position.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+static const int scaling_threads[] = {1, 2, 4, 8, 16};
+
+static bool play(Board& b, Color& c, const std::string& str)
+{
+    if (str.size() != 4) {
+        return false;
+    }
+    auto from = read_square(str.substr(0, 2));
+    auto to = read_square(str.substr(2, 2));
+    if (!from || !to || !try_move(b, c, *from, *to)) {
+        return false;
+    }
+    c = c == WHITE ? BLACK : WHITE;
+    return true;
+}
+
+static std::string show_move(const boost::optional<Move>& m)
+{
+    if (!m) {
+        return "(none)";
+    }
+    SimpleMove e = endpoints(*m);
+    return show(e.from) + show(e.to);
+}
+
+static int usage()
+{
+    std::cerr << "usage: analyze [-t threads] [-d depth] [-m ms] [-h mb] "
+                 "[-f fen] [move...]\n"
+                 "       analyze --scaling [-d depth] [-h mb] [-f fen] "
+                 "[move...]\n"
+                 "moves are given from the initial position or the FEN, "
+                 "e.g. e2e4\n";
+    return 2;
+}
+
+// Time to a fixed depth with a fresh table for each thread count.
+static int scaling(const Board& b, Color c, int depth, size_t table_mb)
+{
+    SearchLimits limits = {std::chrono::hours(24), depth, 1};
+    double base = 0;
+    std::cout << "threads      time       nodes    nodes/s  speedup  move\n";
+    for (int threads : scaling_threads) {
+        TranspositionTable tt(table_mb);
+        limits.threads = threads;
+        SearchResult r = search(b, c, limits, tt);
+        if (threads == 1) {
+            base = r.seconds;
+        }
+        std::cout << std::setw(7) << threads
+                  << std::setw(9) << std::fixed << std::setprecision(3)
+                  << r.seconds << " s"
+                  << std::setw(12) << r.nodes
+                  << std::setw(11) << uint64_t(r.nodes / r.seconds)
+                  << std::setw(8) << std::setprecision(2)
+                  << base / r.seconds << "x"
+                  << "  " << show_move(r.best) << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    SearchLimits limits = {std::chrono::milliseconds(5000), 64, 1};
+    size_t table_mb = default_table_mb;
+    bool run_scaling = false;
+    bool depth_given = false;
+    Board b = initial_position();
+    Color c = WHITE;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            limits.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-d" && i + 1 < argc) {
+            limits.max_depth = std::max(1, std::atoi(argv[++i]));
+            depth_given = true;
+        } else if (arg == "-m" && i + 1 < argc) {
+            limits.time = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else if (arg == "-h" && i + 1 < argc) {
+            table_mb = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-f" && i + 1 < argc) {
+            auto read = from_fen(argv[++i]);
+            if (!read) {
+                std::cerr << "Bad FEN: " << argv[i] << "\n";
+                return 1;
+            }
+            b = *read;
+            c = b.side_to_move();
+        } else if (arg == "--scaling") {
+            run_scaling = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage();
+        } else if (!play(b, c, arg)) {
+            std::cerr << "Illegal move: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (run_scaling) {
+        return scaling(b, c, depth_given ? limits.max_depth : 7, table_mb);
+    }
+
+    TranspositionTable tt(table_mb);
+    SearchResult r = search(b, c, limits, tt);
+    std::cout << "Best move: " << show_move(r.best) << "\n"
+              << "Score: " << r.score << "\n"
+              << "Depth: " << r.depth << "\n"
+              << "Nodes: " << r.nodes << "\n"
+              << "Time: " << r.seconds << " s\n"
+              << "Nodes/s: " << uint64_t(r.seconds > 0 ? r.nodes / r.seconds
+                                                       : 0) << "\n";
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "chess.hpp"
+#include "journal.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+static int usage()
+{
+    std::cerr << "usage: journal_bench [-g games] [-p plies] [-t threads] "
+                 "[-r] file\n";
+    return 2;
+}
+
+static double since(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         begin).count();
+}
+
+// Writes a journal of games played with random legal moves, their records
+// interleaved as on a busy server, and times how fast it was committed.
+static int write_games(const std::string& path, int games, int plies)
+{
+    struct Playing
+    {
+        Board board;
+        Color turn;
+        bool over;
+    };
+    std::vector<Playing> playing(games, {initial_position(), WHITE, false});
+    std::minstd_rand random(1);
+    uint64_t commits = 0, records = games;
+    auto begin = std::chrono::steady_clock::now();
+    try {
+        Journal journal(path, {});
+        for (int g = 0; g < games; ++g) {
+            journal.started(g + 1, WHITE);
+        }
+        for (int ply = 0; ply < plies; ++ply) {
+            for (int g = 0; g < games; ++g) {
+                Playing& p = playing[g];
+                if (p.over) {
+                    continue;
+                }
+                MoveList moves;
+                generate_legal_moves(p.board, p.turn, moves);
+                SimpleMove m = endpoints(moves.moves[random() % moves.size]);
+                auto result = try_move(p.board, p.turn, m.from, m.to);
+                journal.moved(g + 1, m);
+                ++records;
+                p.turn = p.turn == WHITE ? BLACK : WHITE;
+                if (result->opponent_cannot_move) {
+                    journal.ended(g + 1);
+                    ++records;
+                    p.over = true;
+                }
+            }
+        }
+        journal.sync();
+        commits = journal.commits();
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << records << " records of " << games
+              << " games in " << since(begin) << " s, " << commits
+              << " commits.\n";
+    return 0;
+}
+
+// Times recovery of the journal, by default the one written before it.
+int main(int argc, char** argv)
+{
+    int games = 100000, plies = 40;
+    int threads = int(std::thread::hardware_concurrency());
+    bool recover_only = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:p:t:r")) != -1) {
+        switch (opt) {
+        case 'g': games = std::atoi(optarg); break;
+        case 'p': plies = std::atoi(optarg); break;
+        case 't': threads = std::atoi(optarg); break;
+        case 'r': recover_only = true; break;
+        default: return usage();
+        }
+    }
+    if (optind + 1 != argc || games < 1 || plies < 0) {
+        return usage();
+    }
+    std::string path = argv[optind];
+    if (!recover_only) {
+        int status = write_games(path, games, plies);
+        if (status) {
+            return status;
+        }
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    auto recovered = recover_journal(path, threads);
+    double replayed = since(begin);
+    uint64_t moves = 0;
+    for (const RecoveredGame& g : recovered) {
+        moves += g.moves.size();
+    }
+
+    std::cout << "Recovered " << recovered.size() << " live games ("
+              << moves << " moves) on " << threads << " threads in "
+              << replayed << " s.\n";
+    return 0;
+}
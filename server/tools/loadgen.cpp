@@ -0,0 +1,395 @@
+#include "chess.hpp"
+#include "game.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <unistd.h>
+
+namespace asio = boost::asio;
+namespace ip = boost::asio::ip;
+namespace sys = boost::system;
+typedef std::chrono::steady_clock Clock;
+
+// The commands whose round trips are timed, each up to the reply that
+// answers it: "color" for ready, the echoed move, say or resign.
+enum Timed
+{
+    READY_RTT, MOVE_RTT, SAY_RTT, RESIGN_RTT, TIMED
+};
+
+static const char* const timed_names[TIMED] = {"ready", "move", "say",
+                                               "resign"};
+
+struct Options
+{
+    std::string host = "127.0.0.1";
+    unsigned short port = 12345;
+    int clients = 1000;
+    int threads = 1;
+    double seconds = 10;
+    int max_plies = 80;
+    // one in this many turns starts with a say
+    int say_every = 10;
+    unsigned seed = 1;
+};
+
+struct Stats
+{
+    std::vector<uint32_t> latencies[TIMED];
+    uint64_t moves = 0, games = 0, errors = 0;
+};
+
+// One player. It mirrors its game on a local board to pick random legal
+// moves, resigns once the game is max_plies long and readies again after
+// every game. There is never more than one command in flight.
+class Client : public std::enable_shared_from_this<Client>
+{
+public:
+    Client(asio::io_service& io, const Options& options, unsigned seed) :
+        options(options), strand(io), sock(io), random(seed), measuring(false)
+    {}
+
+    void connect(const ip::tcp::endpoint& endpoint,
+                 std::function<void(bool)> connected)
+    {
+        auto self = shared_from_this();
+        sock.async_connect(endpoint, strand.wrap(
+            [this, self, connected](const sys::error_code& error) {
+                connected(!error);
+                if (error) {
+                    std::cerr << "Error: " << error.message() << std::endl;
+                    return;
+                }
+                sock.set_option(ip::tcp::no_delay(true));
+                send(READY_RTT, "ready");
+                read_next();
+            }));
+    }
+
+    // Latencies from before this are not counted.
+    void start_measuring()
+    {
+        auto self = shared_from_this();
+        strand.dispatch([this, self]() {
+            measuring = true;
+            stats = Stats();
+        });
+    }
+
+    void stop()
+    {
+        auto self = shared_from_this();
+        strand.dispatch([this, self]() {
+            sys::error_code ignored;
+            sock.close(ignored);
+        });
+    }
+
+    const Stats& result() const
+    {
+        return stats;
+    }
+private:
+    const Options& options;
+    asio::io_service::strand strand;
+    ip::tcp::socket sock;
+    asio::streambuf buf;
+    std::string out;
+    std::minstd_rand random;
+    bool measuring;
+    Stats stats;
+
+    Board board;
+    Color color = WHITE, turn = WHITE;
+    bool playing = false;
+    int plies = 0;
+
+    Timed pending = TIMED;
+    Clock::time_point sent;
+
+    void send(Timed type, const std::string& line)
+    {
+        pending = type;
+        sent = Clock::now();
+        out = line + '\n';
+        auto self = shared_from_this();
+        asio::async_write(sock, asio::buffer(out), strand.wrap(
+            [this, self](const sys::error_code&, size_t) {}));
+    }
+
+    void answered(Timed type)
+    {
+        if (pending != type) {
+            return;
+        }
+        pending = TIMED;
+        if (measuring) {
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - sent).count();
+            stats.latencies[type].push_back(uint32_t(us));
+        }
+    }
+
+    void read_next()
+    {
+        auto self = shared_from_this();
+        asio::async_read_until(sock, buf, '\n', strand.wrap(
+            [this, self](const sys::error_code& error, size_t size) {
+                if (error) {
+                    return;
+                }
+                const char* data =
+                    asio::buffer_cast<const char*>(buf.data());
+                std::string line(data, size - 1);
+                buf.consume(size);
+                handle(line);
+                read_next();
+            }));
+    }
+
+    void handle(const std::string& line)
+    {
+        Tokenizer words(line);
+        boost::string_view word;
+        if (!words.next(word)) {
+            return;
+        }
+        if (word == "color") {
+            answered(READY_RTT);
+            words.next(word);
+            color = word == "white" ? WHITE : BLACK;
+        } else if (word == "start") {
+            board = initial_position();
+            turn = WHITE;
+            plies = 0;
+            playing = true;
+            play();
+        } else if (word.starts_with("say")) {
+            answered(SAY_RTT);
+            if (playing && turn == color && pending == TIMED) {
+                move();
+            }
+        } else if (word == "resign" || word == "adjudicated") {
+            answered(RESIGN_RTT);
+            game_over();
+        } else if (word == "error") {
+            ++stats.errors;
+        } else {
+            opponent_or_own_move(word, words);
+        }
+    }
+
+    void opponent_or_own_move(boost::string_view word, Tokenizer& words)
+    {
+        Square from, to;
+        if (word == "castle") {
+            words.next(word);
+            int row = turn == WHITE ? 7 : 0;
+            from = {row, 4};
+            to = {row, word == "kingside" ? 6 : 2};
+        } else {
+            boost::string_view f, t;
+            if (!words.next(f) || !words.next(t) || !read_square(f) ||
+                !read_square(t)) {
+                ++stats.errors;
+                return;
+            }
+            from = *read_square(f);
+            to = *read_square(t);
+        }
+        auto result = try_move(board, turn, from, to);
+        if (!result) {
+            ++stats.errors;
+            return;
+        }
+        if (turn == color) {
+            answered(MOVE_RTT);
+            ++stats.moves;
+        }
+        turn = turn == WHITE ? BLACK : WHITE;
+        ++plies;
+        if (result->opponent_cannot_move) {
+            game_over();
+        } else {
+            play();
+        }
+    }
+
+    void play()
+    {
+        if (!playing || turn != color) {
+            return;
+        }
+        if (plies >= options.max_plies) {
+            send(RESIGN_RTT, "resign");
+        } else if (options.say_every > 0 &&
+                   random() % options.say_every == 0) {
+            send(SAY_RTT, "say hello");
+        } else {
+            move();
+        }
+    }
+
+    void move()
+    {
+        MoveList moves;
+        generate_legal_moves(board, color, moves);
+        SimpleMove m = endpoints(moves.moves[random() % moves.size]);
+        send(MOVE_RTT, "move " + show(m.from) + " " + show(m.to));
+    }
+
+    void game_over()
+    {
+        if (!playing) {
+            return;
+        }
+        playing = false;
+        ++stats.games;
+        send(READY_RTT, "ready");
+    }
+};
+
+static int usage()
+{
+    std::cerr << "usage: loadgen [-c clients] [-t threads] [-d seconds] "
+                 "[-m max_plies]\n"
+                 "               [-S say_every] [-s seed] [-h host] "
+                 "[-p port]\n";
+    return 2;
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t i = std::min(sorted.size() - 1, size_t(p * sorted.size()));
+    return sorted[i];
+}
+
+// Connects the clients, lets them play against each other in the rooms the
+// server pairs them into for the given time, and reports the connect rate,
+// the move rate and the round-trip latency of each command.
+int main(int argc, char** argv)
+{
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:d:m:S:s:h:p:")) != -1) {
+        switch (opt) {
+        case 'c': options.clients = std::atoi(optarg); break;
+        case 't': options.threads = std::max(1, std::atoi(optarg)); break;
+        case 'd': options.seconds = std::atof(optarg); break;
+        case 'm': options.max_plies = std::atoi(optarg); break;
+        case 'S': options.say_every = std::atoi(optarg); break;
+        case 's': options.seed = unsigned(std::atol(optarg)); break;
+        case 'h': options.host = optarg; break;
+        case 'p': options.port = (unsigned short)std::atoi(optarg); break;
+        default: return usage();
+        }
+    }
+    // the server seats connections in pairs
+    if (optind != argc || options.clients < 2 || options.clients % 2) {
+        return usage();
+    }
+
+    asio::io_service io;
+    sys::error_code error;
+    auto address = ip::address::from_string(options.host, error);
+    if (error) {
+        std::cerr << "Error: bad address " << options.host << std::endl;
+        return 1;
+    }
+    ip::tcp::endpoint endpoint(address, options.port);
+
+    std::vector<std::shared_ptr<Client>> clients;
+    std::atomic<int> connected(0), failed(0);
+    Clock::time_point begin = Clock::now(), all_connected;
+    asio::steady_timer timer(io);
+    auto finish = [&]() {
+        for (auto& client : clients) {
+            client->stop();
+        }
+    };
+    auto on_connect = [&](bool ok) {
+        ++(ok ? connected : failed);
+        if (connected + failed != options.clients) {
+            return;
+        }
+        all_connected = Clock::now();
+        for (auto& client : clients) {
+            client->start_measuring();
+        }
+        timer.expires_from_now(std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options.seconds)));
+        timer.async_wait([&](const sys::error_code&) { finish(); });
+    };
+    for (int i = 0; i < options.clients; ++i) {
+        clients.push_back(std::make_shared<Client>(io, options,
+                                                   options.seed + i));
+    }
+    for (auto& client : clients) {
+        client->connect(endpoint, on_connect);
+    }
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < options.threads; ++t) {
+        pool.emplace_back([&io]() { io.run(); });
+    }
+    io.run();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    Clock::time_point end = Clock::now();
+
+    Stats total;
+    for (auto& client : clients) {
+        const Stats& s = client->result();
+        for (int t = 0; t < TIMED; ++t) {
+            total.latencies[t].insert(total.latencies[t].end(),
+                                      s.latencies[t].begin(),
+                                      s.latencies[t].end());
+        }
+        total.moves += s.moves;
+        total.games += s.games;
+        total.errors += s.errors;
+    }
+
+    double connect_seconds =
+        std::chrono::duration<double>(all_connected - begin).count();
+    double run_seconds =
+        std::chrono::duration<double>(end - all_connected).count();
+    std::cout << std::fixed << std::setprecision(3)
+              << "Connected " << connected << " clients (" << failed
+              << " failed) in " << connect_seconds << " s, "
+              << std::setprecision(0) << connected / connect_seconds
+              << " connections/s\n"
+              << std::setprecision(3)
+              << "Played " << total.moves << " moves, " << total.games
+              << " games in " << run_seconds << " s, "
+              << std::setprecision(0) << total.moves / run_seconds
+              << " moves/s, " << total.errors << " errors\n"
+              << "command     count     p50 us     p99 us    p999 us"
+                 "     max us\n";
+    for (int t = 0; t < TIMED; ++t) {
+        auto& l = total.latencies[t];
+        std::sort(l.begin(), l.end());
+        std::cout << std::left << std::setw(8) << timed_names[t]
+                  << std::right << std::setw(9) << l.size()
+                  << std::setw(11) << percentile(l, 0.5)
+                  << std::setw(11) << percentile(l, 0.99)
+                  << std::setw(11) << percentile(l, 0.999)
+                  << std::setw(11) << (l.empty() ? 0 : l.back()) << "\n";
+    }
+    return failed || total.errors ? 1 : 0;
+}
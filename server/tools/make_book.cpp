@@ -0,0 +1,128 @@
+#include "book.hpp"
+#include "chess.hpp"
+#include "pgn.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct Seen
+{
+    uint64_t key;
+    uint16_t move;
+
+    bool operator<(const Seen& o) const
+    {
+        return key != o.key ? key < o.key : move < o.move;
+    }
+    bool operator==(const Seen& o) const
+    {
+        return key == o.key && move == o.move;
+    }
+};
+
+static int usage()
+{
+    std::cerr << "usage: make_book [-p plies] [-n min_games] out.book "
+                 "games.pgn...\n";
+    return 2;
+}
+
+// Replays the first plies of a game through try_move. Stops at the first
+// move the rules engine rejects, e.g. en passant; returns whether the
+// whole prefix was played.
+static bool replay(const std::vector<boost::string_view>& sans, int plies,
+                   std::vector<Seen>& seen)
+{
+    Board b = initial_position();
+    Color c = WHITE;
+    for (size_t i = 0; i < sans.size() && int(i) < plies; ++i) {
+        auto m = read_san(b, c, sans[i]);
+        if (!m) {
+            return false;
+        }
+        SimpleMove e = endpoints(*m);
+        uint64_t key = b.hash();
+        if (!try_move(b, c, e.from, e.to)) {
+            return false;
+        }
+        seen.push_back(Seen{key, book_move(e)});
+        c = c == WHITE ? BLACK : WHITE;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int plies = 20;
+    int min_games = 1;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-p" && i + 1 < argc) {
+            plies = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-n" && i + 1 < argc) {
+            min_games = std::max(1, std::atoi(argv[++i]));
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage();
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() < 2) {
+        return usage();
+    }
+
+    std::vector<Seen> seen;
+    size_t games = 0, cut_short = 0;
+    for (size_t i = 1; i < paths.size(); ++i) {
+        std::ifstream in(paths[i], std::ios::binary);
+        if (!in) {
+            std::cerr << "Cannot read " << paths[i] << "\n";
+            return 1;
+        }
+        std::string text((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+        PgnReader reader(text);
+        std::vector<boost::string_view> sans;
+        while (reader.next_game(sans)) {
+            ++games;
+            cut_short += !replay(sans, plies, seen);
+        }
+    }
+
+    std::sort(seen.begin(), seen.end());
+    std::vector<BookEntry> entries;
+    size_t positions = 0;
+    for (size_t i = 0; i < seen.size(); ) {
+        size_t j = i;
+        while (j < seen.size() && seen[j] == seen[i]) {
+            ++j;
+        }
+        if (int(j - i) >= min_games) {
+            positions += entries.empty() || entries.back().key != seen[i].key;
+            BookEntry e = BookEntry();
+            e.key = seen[i].key;
+            e.move = seen[i].move;
+            e.weight = uint16_t(std::min<size_t>(j - i, 65535));
+            entries.push_back(e);
+        }
+        i = j;
+    }
+
+    std::ofstream out(paths[0], std::ios::binary);
+    write_book(out, entries);
+    if (!out) {
+        std::cerr << "Cannot write " << paths[0] << "\n";
+        return 1;
+    }
+    std::cout << "Games: " << games << " (" << cut_short
+              << " stopped early at a move the rules engine lacks)\n"
+              << "Positions: " << positions << "\n"
+              << "Moves: " << entries.size() << "\n";
+    return 0;
+}
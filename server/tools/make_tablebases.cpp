@@ -0,0 +1,45 @@
+#include "tablebase.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Generates every table into a directory, in an order that has KQK ready
+// before KPK needs it.
+int main(int argc, char** argv)
+{
+    if (argc != 2) {
+        std::cerr << "usage: make_tablebases dir\n";
+        return 2;
+    }
+    std::string dir = argv[1];
+
+    Tablebases tb;
+    for (int e = 0; e < ENDGAMES; ++e) {
+        Endgame endgame = Endgame(e);
+        std::string path = dir + "/" + endgame_name(endgame) + ".tb";
+        auto start = std::chrono::steady_clock::now();
+        std::vector<int8_t> values = generate_table(endgame, tb);
+        double secs = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+
+        int longest = 0;
+        size_t wins = 0;
+        for (int8_t v : values) {
+            longest = std::max(longest, int(v));
+            wins += v != 0;
+        }
+        std::ofstream out(path, std::ios::binary);
+        write_table(out, endgame, values);
+        if (!out) {
+            std::cerr << "Cannot write " << path << "\n";
+            return 1;
+        }
+        std::cout << endgame_name(endgame) << ": " << wins
+                  << " decided positions, longest mate " << longest
+                  << " plies, " << secs << " s\n";
+        tb.add(endgame, std::move(values));
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "game.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/algorithm/string.hpp>
+
+// Measures the per-line cost of turning an inbound protocol line into a
+// Command, next to the trim + split path the server used before.
+
+static const char* corpus[] = {
+    "move e2 e4",
+    "move g8 f6",
+    "say good luck, have fun",
+    "move e1 g1",
+    "ready",
+    "move  d7   d5 ",
+    "resign",
+    "move a7 a8\r"
+};
+
+template <typename F>
+static double ns_per_line(int iterations, F parse)
+{
+    size_t lines = sizeof(corpus) / sizeof(corpus[0]);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (size_t j = 0; j < lines; ++j) {
+            parse(corpus[j]);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+           (double(iterations) * lines);
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    volatile int sink = 0;
+
+    double split = ns_per_line(iterations, [&](const char* line) {
+        std::string msg = line;
+        std::vector<std::string> words;
+        boost::trim(msg);
+        boost::split(words, msg, boost::is_any_of("\t "),
+                     boost::token_compress_on);
+        if (words.size() == 3) {
+            auto from = read_square(words[1]);
+            auto to = read_square(words[2]);
+            sink = sink + (from ? from->row : 0) + (to ? to->col : 0);
+        }
+    });
+
+    double view = ns_per_line(iterations, [&](const char* line) {
+        Command cmd = read_command(line);
+        sink = sink + cmd.type + (cmd.from ? cmd.from->row : 0) +
+               (cmd.to ? cmd.to->col : 0);
+    });
+
+    std::cout << "trim + split:  " << split << " ns/line\n"
+              << "read_command:  " << view << " ns/line\n";
+    return 0;
+}
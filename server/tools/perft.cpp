@@ -0,0 +1,194 @@
+#include "chess.hpp"
+#include "game.hpp"
+#include "position.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Reference counts from the initial position. Deeper plies include en
+// passant captures, which the rules engine does not implement.
+static const uint64_t reference_counts[] = {1, 20, 400, 8902, 197281};
+
+struct RootMove
+{
+    Square from, to;
+    Move move;
+    uint64_t nodes;
+};
+
+static uint64_t perft(Board& b, Color c, int depth)
+{
+    if (depth == 0) {
+        return 1;
+    }
+
+    MoveList moves;
+    generate_legal_moves(b, c, moves);
+    if (depth == 1) {
+        return moves.size;
+    }
+
+    Color next = c == WHITE ? BLACK : WHITE;
+    uint64_t nodes = 0;
+    for (const Move& m : moves) {
+        Undo u = apply(b, m);
+        nodes += perft(b, next, depth - 1);
+        undo(b, m, u);
+    }
+    return nodes;
+}
+
+static std::vector<RootMove> root_moves(Board& b, Color c)
+{
+    MoveList legal;
+    generate_legal_moves(b, c, legal);
+    std::vector<RootMove> moves;
+    for (const Move& m : legal) {
+        SimpleMove ends = endpoints(m);
+        moves.push_back(RootMove{ends.from, ends.to, m, 0});
+    }
+    return moves;
+}
+
+static uint64_t divide(Board& b, Color c, int depth, int threads,
+                       std::vector<RootMove>& moves)
+{
+    moves = root_moves(b, c);
+    if (depth == 0) {
+        return 1;
+    }
+
+    Color next = c == WHITE ? BLACK : WHITE;
+    std::atomic<size_t> next_move(0);
+    auto worker = [&]() {
+        Board board = b;
+        for (size_t i = next_move++; i < moves.size(); i = next_move++) {
+            Undo u = apply(board, moves[i].move);
+            moves[i].nodes = perft(board, next, depth - 1);
+            undo(board, moves[i].move, u);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+
+    uint64_t nodes = 0;
+    for (const RootMove& rm : moves) {
+        nodes += rm.nodes;
+    }
+    return nodes;
+}
+
+static bool play(Board& b, Color& c, const std::string& str)
+{
+    if (str.size() != 4) {
+        return false;
+    }
+    auto from = read_square(str.substr(0, 2));
+    auto to = read_square(str.substr(2, 2));
+    if (!from || !to || !try_move(b, c, *from, *to)) {
+        return false;
+    }
+    c = c == WHITE ? BLACK : WHITE;
+    return true;
+}
+
+static int usage()
+{
+    std::cerr << "usage: perft [-t threads] [-f fen] depth [move...]\n"
+                 "       perft --check [-t threads]\n"
+                 "moves are given from the initial position or the FEN, "
+                 "e.g. e2e4\n";
+    return 2;
+}
+
+static int check(int threads)
+{
+    int failures = 0;
+    int depths = sizeof(reference_counts) / sizeof(reference_counts[0]);
+    for (int depth = 0; depth < depths; ++depth) {
+        std::vector<RootMove> moves;
+        Board b = initial_position();
+        uint64_t nodes = divide(b, WHITE, depth, threads, moves);
+        bool ok = nodes == reference_counts[depth];
+        std::cout << "depth " << depth << ": " << nodes
+                  << (ok ? " ok" : " FAILED, expected ")
+                  << (ok ? "" : std::to_string(reference_counts[depth]))
+                  << "\n";
+        failures += !ok;
+    }
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    int threads = 1;
+    bool run_check = false;
+    int depth = -1;
+    Board b = initial_position();
+    Color c = WHITE;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-f" && i + 1 < argc) {
+            auto read = from_fen(argv[++i]);
+            if (!read) {
+                std::cerr << "Bad FEN: " << argv[i] << "\n";
+                return 1;
+            }
+            b = *read;
+            c = b.side_to_move();
+        } else if (arg == "--check") {
+            run_check = true;
+        } else if (arg[0] == '-') {
+            return usage();
+        } else if (depth < 0) {
+            char* end;
+            long n = std::strtol(arg.c_str(), &end, 10);
+            if (end == arg.c_str() || *end || n < 0 || n > 64) {
+                return usage();
+            }
+            depth = int(n);
+        } else if (!play(b, c, arg)) {
+            std::cerr << "Illegal move: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (run_check) {
+        return check(threads);
+    }
+    if (depth < 0) {
+        return usage();
+    }
+
+    std::vector<RootMove> moves;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = divide(b, c, depth, threads, moves);
+    auto end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+
+    if (depth > 0) {
+        for (const RootMove& rm : moves) {
+            std::cout << show(rm.from) << show(rm.to) << ": "
+                      << rm.nodes << "\n";
+        }
+        std::cout << "\n";
+    }
+    std::cout << "Nodes: " << nodes << "\n"
+              << "Time: " << secs << " s\n"
+              << "Nodes/s: " << uint64_t(secs > 0 ? nodes / secs : 0) << "\n";
+    return 0;
+}
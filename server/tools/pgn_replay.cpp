@@ -0,0 +1,224 @@
+#include "chess.hpp"
+#include "mapped_file.hpp"
+#include "pgn.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Each thread takes the next chunk of about this many bytes, widened to
+// whole games, and gives its pages back once it has been replayed.
+static const size_t chunk_size = size_t(1) << 20;
+
+static const char* const results[] = {"1-0", "0-1", "1/2-1/2", "*"};
+
+struct Totals
+{
+    uint64_t games = 0, plies = 0, illegal = 0;
+    uint64_t results[4] = {};
+    uint64_t mates = 0, stalemates = 0, mismatched = 0;
+
+    void add(const Totals& o)
+    {
+        games += o.games;
+        plies += o.plies;
+        illegal += o.illegal;
+        for (int i = 0; i < 4; ++i) {
+            results[i] += o.results[i];
+        }
+        mates += o.mates;
+        stalemates += o.stalemates;
+        mismatched += o.mismatched;
+    }
+};
+
+static int usage()
+{
+    std::cerr << "usage: pgn_replay [-t threads] [-q] games.pgn...\n";
+    return 2;
+}
+
+// The first game starting at or after offset: a tag line right after a
+// blank line. Splitting there instead of anywhere between tags keeps every
+// game in one chunk.
+static size_t game_start(boost::string_view text, size_t offset)
+{
+    if (offset == 0) {
+        return 0;
+    }
+    for (size_t p = offset - 1; ; ++p) {
+        p = text.find("\n[", p);
+        if (p == boost::string_view::npos) {
+            return text.size();
+        }
+        size_t line = p;
+        while (line > 0 && (text[line - 1] == ' ' || text[line - 1] == '\t' ||
+                            text[line - 1] == '\r')) {
+            --line;
+        }
+        if (line == 0 || text[line - 1] == '\n') {
+            return p + 1;
+        }
+    }
+}
+
+class Replayer
+{
+public:
+    Replayer(const std::string& name, const MappedFile& file, bool quiet) :
+        name(name), file(file), text(file.data(), file.size()), quiet(quiet),
+        next_chunk(0)
+    {}
+
+    void run(Totals& totals)
+    {
+        std::vector<boost::string_view> sans;
+        for (;;) {
+            size_t chunk = next_chunk++;
+            size_t begin = game_start(text, chunk * chunk_size);
+            if (begin >= text.size()) {
+                return;
+            }
+            size_t end = game_start(text, (chunk + 1) * chunk_size);
+            PgnReader reader(text.substr(begin, end - begin));
+            for (;;) {
+                size_t at = begin + reader.position();
+                if (!reader.next_game(sans)) {
+                    break;
+                }
+                replay(sans, reader.result(), at, totals);
+            }
+            file.release(begin, end - begin);
+        }
+    }
+private:
+    const std::string& name;
+    const MappedFile& file;
+    boost::string_view text;
+    bool quiet;
+    std::atomic<size_t> next_chunk;
+    std::mutex report_mutex;
+
+    void replay(const std::vector<boost::string_view>& sans,
+                boost::string_view result, size_t at, Totals& totals)
+    {
+        ++totals.games;
+        int outcome = 3;
+        for (int i = 0; i < 4; ++i) {
+            if (result == results[i]) {
+                outcome = i;
+            }
+        }
+        ++totals.results[outcome];
+
+        Board b = initial_position();
+        Color c = WHITE;
+        for (size_t i = 0; i < sans.size(); ++i) {
+            auto m = read_san(b, c, sans[i]);
+            if (!m) {
+                ++totals.illegal;
+                if (!quiet) {
+                    std::lock_guard<std::mutex> lock(report_mutex);
+                    std::cout << name << ":" << at << ": move " << i / 2 + 1
+                              << (c == WHITE ? ". " : "... ") << sans[i]
+                              << " is illegal\n";
+                }
+                return;
+            }
+            apply(b, *m);
+            c = c == WHITE ? BLACK : WHITE;
+            ++totals.plies;
+        }
+
+        if (can_move(b, c)) {
+            return;
+        }
+        bool mate = in_check(b, c);
+        ++(mate ? totals.mates : totals.stalemates);
+        int expected = !mate ? 2 : c == WHITE ? 1 : 0;
+        if (outcome != 3 && outcome != expected) {
+            ++totals.mismatched;
+            if (!quiet) {
+                std::lock_guard<std::mutex> lock(report_mutex);
+                std::cout << name << ":" << at << ": "
+                          << (mate ? "checkmate" : "stalemate")
+                          << " recorded as " << result << "\n";
+            }
+        }
+    }
+};
+
+// Replays every game of the files through read_san and apply, on all the
+// threads at once, and reports the moves the rules reject, results that
+// disagree with a final mate or stalemate, and the throughput.
+int main(int argc, char** argv)
+{
+    int threads = int(std::thread::hardware_concurrency());
+    bool quiet = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:q")) != -1) {
+        switch (opt) {
+        case 't': threads = std::atoi(optarg); break;
+        case 'q': quiet = true; break;
+        default: return usage();
+        }
+    }
+    if (optind == argc) {
+        return usage();
+    }
+    threads = std::max(1, threads);
+
+    Totals totals;
+    uint64_t bytes = 0;
+    auto begin = std::chrono::steady_clock::now();
+    try {
+        for (int i = optind; i < argc; ++i) {
+            std::string name = argv[i];
+            MappedFile file(name, MappedFile::SEQUENTIAL);
+            bytes += file.size();
+            Replayer replayer(name, file, quiet);
+            std::vector<Totals> parts(threads);
+            std::vector<std::thread> pool;
+            for (int t = 1; t < threads; ++t) {
+                pool.emplace_back([&, t]() { replayer.run(parts[t]); });
+            }
+            replayer.run(parts[0]);
+            for (std::thread& t : pool) {
+                t.join();
+            }
+            for (const Totals& part : parts) {
+                totals.add(part);
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << "Games: " << totals.games << "\n"
+              << "Plies: " << totals.plies << "\n"
+              << "Illegal: " << totals.illegal << "\n"
+              << "Results:";
+    for (int i = 0; i < 4; ++i) {
+        std::cout << " " << results[i] << " " << totals.results[i];
+    }
+    std::cout << "\n"
+              << "Checkmates: " << totals.mates << ", stalemates: "
+              << totals.stalemates << ", mismatched results: "
+              << totals.mismatched << "\n"
+              << "Time: " << seconds << " s on " << threads << " threads\n"
+              << std::fixed << std::setprecision(0)
+              << "Games/s: " << totals.games / seconds << ", MB/s: "
+              << std::setprecision(1) << bytes / seconds / 1e6 << "\n";
+    return totals.illegal || totals.mismatched ? 1 : 0;
+}